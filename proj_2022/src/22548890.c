@@ -27,19 +27,35 @@
  *    IMPORTANT NOTE:
  *        Write any (debugging) output you would like to see to a file. 
  *        	- This can be done using file fp, and fprintf()
- *        	- Don't forget to flush the streamint alpha_sharing_top(int alpha)
+ *        	- Don't forget to flush the stream
  * https://www.geeksforgeeks.org/minimax-algorithm-in-game-theory-set-4-alpha-beta-pruning/?ref=lbp
  * https://www.javatpoint.com/mini-max-algorithm-in-ai
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <mpi.h>
+#include <pthread.h>
 #include <time.h>
 #include <assert.h>
+#include <math.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include "comms.h"
+#include "bitboard.h"
+#include "tt.h"
+#include "dtt.h"
+#include "nodett.h"
+#include "endgame.h"
+#include "book.h"
+#include "pattern.h"
+#include "order.h"
+#include "probcut.h"
+#include "mpiprof.h"
 #include <stdarg.h>
 #include <unistd.h>
 
@@ -48,38 +64,98 @@ const int BLACK = 1;
 const int WHITE = 2;
 const int MAX = 1000000000;
 const int MIN = -1000000000;
-const int MAXDEPTH = 8;
-
-const int OUTER = 3;
-const int ALLDIRECTIONS[8] = {-11, -10, -9, -1, 1, 9, 10, 11};
-const int BOARDSIZE = 100;
+const int MAXDEPTH = 60;
+const double TIME_FRACTION = 0.85; //share of the referee time limit spent searching
+const double TIME_RESERVE = 0.25;  //seconds kept back for comms and process overhead
+const int TIMECHECKNODES = 1024;   //nodes between clock reads
+const int WIN_WEIGHT = 100000;	   //per disc of a finished game, outweighs any heuristic score
+
+const int DISPATCH_STATIC = 0;	//root moves split round robin by rank
+const int DISPATCH_DYNAMIC = 1; //rank 0 hands out root moves on request
+const int EVAL_CLASSIC = 0;		//the hand tuned three phase evaluatePosition
+const int EVAL_PATTERN = 1;		//pattern tables interpolated by disc count
+const int SEARCH_ALPHABETA = 0; //every move searched with the full window
+const int SEARCH_PVS = 1;		//null windows for later siblings, aspiration windows at the root
+const int ASPIRATION_WINDOW = 200; //half width of the root window around the last iteration's score
+const int PONDER = 2;			//value of running that starts a ponder search instead of a move
+const int BOUND_STOP = 1;		//bound_win cell rank 0 stops a search through, by its search_serial
+const double STOP_GRACE = 0.1;	//seconds past the deadline other ranks wait for rank 0's stop
+const int WORKREQUEST_TAG = 10; //worker to rank 0: last root result, wants work
+const int CTRL_TAG = 11;		//rank 0 to a worker: root move, helper list or idle notice
+const int HELPREQUEST_TAG = 12; //split point owner to rank 0: wants idle ranks
+const int SPLIT_TAG = 13;		//split point owner to helper: job, abort or release
+const int SPLITRESULT_TAG = 14; //helper to split point owner
+const int SPLIT_MIN_DEPTH = 4;	//nodes with less depth left search their siblings serially
+const int SMP_MIN_DEPTH = 4;	//subtrees with less depth left are not worth waking the other threads for
+
+const int CTRL_JOB = 0;
+const int CTRL_HELPERS = 1;
+const int CTRL_IDLE = 2;
+const int SPLIT_JOB = 0;
+const int SPLIT_ABORT = 1;
+const int SPLIT_RELEASE = 2;
+
+#define MAXSPLITHELPERS 16
+#define CTRLMSGSIZE (MAXSPLITHELPERS + 2)
+#define SPLITMSGSIZE 10
+#define MAXTHREADS 64
 
 const int LEGALMOVSBUFSIZE = 65;
 const char piecenames[4] = {'.', 'b', 'w', '?'};
 
+/**
+ * What one rank did for the current move, gathered by rank 0 along with its
+ * best move. All doubles so the record goes as one MPI_DOUBLE array
+ */
+typedef struct
+{
+	double loc, score;			 //best root move of the rank and its score
+	double nodes, leaves;		 //helper threads included
+	double cutoffs, first;		 //beta cutoffs of the main thread, and those by the first move
+	double depth;				 //last completed iteration, 0 for a book move
+	double iter_nodes[2];		 //nodes of the last completed iteration and the one before
+	double seconds, busy;		 //in minimax_strategy, and of that searching rather than waiting
+	double dtt_probes, dtt_hits; //lookups in the distributed table, and those that found their position
+} move_record_t;
+#define MOVERECORDSIZE (int)(sizeof(move_record_t) / sizeof(double))
+
+/**
+ * What rank 0 tells the others before each search, in one broadcast: whether
+ * to search, the position and whose move it is, and the book move if rank 0
+ * found one. All uint64_t so it goes as one MPI_UINT64_T array
+ */
+typedef struct
+{
+	uint64_t disc[2];	//board.disc of the position
+	uint64_t running;	//0 to stop, 1 for a move, PONDER
+	uint64_t colour;	//player to move
+	uint64_t book_move; //book move + 1, 0 to search
+} sync_msg_t;
+#define SYNCMSGSIZE (int)(sizeof(sync_msg_t) / sizeof(uint64_t))
+
 void run_master(int argc, char *argv[], FILE *fp);
-int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, FILE **fp);
+int initialise_master(int argc, char *argv[], double *time_limit, int *my_colour, FILE **fp);
 void gen_move_master(char *move, int my_colour, FILE *fp);
 void apply_opp_move(char *move, int my_colour, FILE *fp);
 void game_over();
 void run_worker(FILE *fp);
+void build_book(int argc, char *argv[]);
 void initialise_board();
-void free_board();
 
 void legal_moves(int player, int *moves, FILE *fp);
 int legalp(int move, int player, FILE *fp);
 int validp(int move);
-int would_flip(int move, int dir, int player, FILE *fp);
 int opponent(int player, FILE *fp);
-int find_bracket_piece(int square, int dir, int player, FILE *fp);
 int random_strategy(int my_colour, FILE *fp);
-void make_move(int move, int player, FILE *fp);
-void make_flips(int move, int dir, int player, FILE *fp);
+uint64_t make_move(int move, int player, FILE *fp);
+void make_flips(uint64_t flips, int player, FILE *fp);
+void unmake_move(int move, uint64_t flips, int player, FILE *fp);
+void features_init();
 int get_loc(char *movestring);
 void get_move_string(int loc, char *ms);
 void print_board(FILE *fp);
 char nameof(int piece);
-int count(int player, int *board);
+int count(int player, bitboard_t *b);
 
 int location_strategy(int my_colour, FILE *fp);
 int find_highestPos(int *moves);
@@ -87,20 +163,54 @@ int max(int num1, int num2);
 int min(int num1, int num2);
 int minimax_score(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta);
 int minimax_strategy(int my_colour, FILE *fp);
+void rank_legal_moves(int my_colour, int *rank_moves, FILE *fp);
 int evaluatePosition(int my_colour, FILE *fp);
 int evaluateMobility(int my_colour, FILE *fp);
 int evaluateDiscDifference(int my_colour, FILE *fp);
-void duplicateBoard(int *board, int *cBoard);
+int weightSum(uint64_t discs, int weights[8][8]);
 int evaluateStability(int my_colour, FILE *fp);
 int evaluateCorners(int my_colour, FILE *fp);
 int evaluateGameTime(int my_colour, FILE *fp);
 int evaluateCorner(int my_colour, FILE *fp);
 int all_in_one(int my_colour, int d, int c, int s, int m, int e, int w);
-void sortMoves(int *moves);
-int get_best_loc(int *buff);
-int alpha_sharing_top(int alpha, int my_rank);
-
-int send_arrMovesScore[2];
+void rotateMoves(int *moves, int by);
+int get_best_loc(move_record_t *records);
+void log_move_stats(move_record_t *records, int loc, FILE *fp);
+void bound_init();
+void bound_free();
+void publish_root_score(int score);
+void refresh_root_bound();
+void set_move_budget(double time_limit);
+int search_timeout();
+int search_iteration(int my_colour, int *best_score, FILE *fp);
+int search_root_move(int loc, int my_colour, FILE *fp);
+int dispatch_master(int my_colour, int *best_score, FILE *fp);
+void dispatch_worker(int my_colour, FILE *fp);
+void serve_work_requests();
+void poll_messages();
+int split_point(int depth, int bMaxMin, int my_colour, int *moves, int *alpha, int *beta, int *best, int *best_move, FILE *fp);
+void help_owner(int owner, FILE *fp);
+void smp_init();
+void smp_free();
+void *smp_helper(void *arg);
+int smp_search(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta);
+int search_child(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta, int first);
+int probcut(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta, int *score);
+int shared_bound();
+void probcut_stats(int argc, char *argv[]);
+int bench(int argc, char *argv[]);
+int bench_heap(int depth);
+int depth_arg(const char *arg);
+size_t heap_in_use();
+long perft(int depth, int player, FILE *fp);
+int ponder_predict(int my_colour, FILE *fp);
+void ponder_strategy(int my_colour, FILE *fp);
+void stop_check();
+int partial_iteration(int last_move, int best_score);
+void sync_ranks(int *running, int *colour, FILE *fp);
+
+move_record_t move_record;
+int book_move; //of the last sync_ranks, -1 if the position is searched
 int size;
 int rank;
 
@@ -122,21 +232,175 @@ int cornersWeights[8][8] = {{10, 1, 5, 3, 3, 5, 1, 10},
 							{1, 0, 2, 2, 2, 2, 0, 1},
 							{10, 1, 5, 3, 3, 5, 1, 10}};
 
-int *board;
+/* Discs of one colour in the global board */
+#define DISCS(colour) (board.disc[(colour)-1])
+
+/* Corner squares "00", "07", "70" and "77" */
+#define CORNERS 0x8100000000000081ULL
+
+/*
+ * Everything the search writes is per thread, so the helper threads of a rank
+ * can search their own copy of the position next to the MPI thread. MPI is
+ * only ever called from the main thread.
+ */
+_Thread_local int thread_id; //0 for the main thread of a rank
+_Thread_local bitboard_t board;
+_Thread_local uint64_t board_hash; //Zobrist key of board, kept up to date by make_move
+
+/*
+ * Evaluation terms that only depend on which squares each colour holds, kept
+ * up to date by make_move and make_flips so leaves read them instead of
+ * scanning the board. Indexed by colour - 1 like board.disc.
+ */
+typedef struct
+{
+	int discs[2];
+	int stability[2];		  //weightSum over stabilityWeights2
+	int corners[2];			  //weightSum over cornersWeights
+	int corner_discs[2];	  //discs on CORNERS, which can never be flipped
+	pattern_index_t patterns; //black discs are digit 1, white discs digit 2
+} features_t;
+_Thread_local features_t features;
+size_t tt_bytes;
+int tt_sharers = 1; //ranks using this rank's table, more than one with a node table
+size_t dtt_bytes;
 int best_val;
-int alpha_sharing;
+
+MPI_Win bound_win;	  //two 64 bit cells on rank 0, the best root score of the current iteration and the last search stopped
+int64_t *bound_cell;  //local memory of bound_win, only non-empty on rank 0
+int bound_serial;	  //counts iterations over the game, tags published scores
+int search_serial;	  //counts calls of minimax_strategy, which every rank makes together
+_Atomic int root_bound = MIN; //best root score any rank has published this iteration, read by every thread
+
+int probcut_enabled;		 //fits were loaded for the evaluation in use
+_Thread_local int in_probcut; //inside the shallow search of a ProbCut check
+
+double move_budget;		//seconds each rank may search for one move
+double search_deadline; //MPI_Wtime at which the current iteration is abandoned
+_Thread_local int search_depth;	  //depth of the current iterative deepening iteration
+_Thread_local int search_stopped; //set once the deadline passes, unwinds the search
+_Thread_local long search_nodes;
+_Thread_local long search_leaves;
+long smp_nodes, smp_leaves; //helper thread totals for the current move, under smp_lock
+double busy_seconds;		//time this rank spent in root moves and split point jobs this move
+
+/**
+ * Per depth scratch space for the search, so no node touches the heap
+ */
+typedef struct
+{
+	int moves[SQUARES + 1]; //moves[0] holds the count, as filled by legal_moves
+} search_frame_t;
+
+_Thread_local search_frame_t search_stack[SQUARES + 1]; //the search never goes deeper than the empty squares
+
+int dispatch_mode;
+int eval_mode;
+int search_mode;
+int aspiration_low = MIN, aspiration_high = MAX; //root window of the current iteration
+int endgame_empties = EG_DEFAULT_EMPTIES; //solve exactly from here, OTHELLO_ENDGAME, 0 turns the solver off
+int solve_window;						   //EG_EXACT or EG_WLD while the current iteration is a solve, else 0
+int serving_requests; //rank 0 answers work requests from inside its own search
+int *parked_ranks;	  //rank 0: idle ranks that can be sent to split points
+int parked_count;
+int split_owner = -1; //rank whose split point this rank is helping at
+_Thread_local int split_aborted; //the owner no longer needs the current job, unwinds the search
+int helpers_hint;	  //rank 0 reported idle ranks since the last empty help request
+
+/**
+ * Root moves rank 0 hands out in dynamic dispatch mode, most expensive first
+ */
+struct
+{
+	int moves[SQUARES + 1]; //moves[0] holds the count
+	long cost[SQUARES + 1]; //nodes each move took in the previous iteration
+	int score[SQUARES + 1];
+	int next;				//next queue position to hand out
+} root_queue;
+
+/**
+ * Lazy SMP inside a rank: helper threads search the same subtree as the main
+ * thread with their own move order and meet it through the shared
+ * transposition table. Only the main thread's score is used.
+ */
+int smp_threads = 1; //search threads per rank including the main thread, OTHELLO_THREADS
+pthread_t smp_pool[MAXTHREADS];
+pthread_mutex_t smp_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t smp_start = PTHREAD_COND_INITIALIZER; //a new job or shutdown
+pthread_cond_t smp_done = PTHREAD_COND_INITIALIZER;	 //the last helper left the job
+int smp_generation;									 //bumped for every job handed out
+int smp_busy;										 //helpers still inside the current job
+int smp_quit;
+_Atomic int smp_abort; //the main thread has its score, helpers unwind
+struct
+{
+	bitboard_t board;
+	int depth, bMaxMin, colour, alpha, beta, search_depth;
+} smp_job;
+
+/**
+ * Search of the position after the predicted reply, run on the opponent's
+ * time. A ponder hit resumes its iterative deepening where it stopped.
+ */
+struct
+{
+	int enabled;	  //rank 0 only, OTHELLO_PONDER=0 turns it off
+	int pondering;	  //the current search runs on the opponent's time
+	bitboard_t board; //position searched, our move
+	int depth;		  //last completed iteration, 0 if none
+	int solved;		  //the last iteration was a solve
+	int best_move, best_val, last_score;
+} ponder;
 
 int main(int argc, char *argv[])
 {
 
 	FILE *fp = NULL;
-	MPI_Init(&argc, &argv);
+	int provided;
+	int offline;
+	int status = 0;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	offline = (argc > 1 && strncmp(argv[1], "--", 2) == 0); //--build-book, --probcut-stats or --bench
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	parked_ranks = (int *)malloc(size * sizeof(int));
+	bound_init();
 	initialise_board(); //one for each process
+	// table size in MB can be set per node with OTHELLO_TT_MB. The ranks of a node share one table,
+	// OTHELLO_TT_SHARED=0 (set for every rank) gives each its own. So do --probcut-stats and --bench,
+	// whose ranks search unrelated positions and clear the table between them
+	if ((getenv("OTHELLO_TT_SHARED") == NULL || atoi(getenv("OTHELLO_TT_SHARED")) != 0) &&
+		!(argc > 1 && (strcmp(argv[1], "--probcut-stats") == 0 || strcmp(argv[1], "--bench") == 0)))
+		tt_bytes = nodett_init(getenv("OTHELLO_TT_MB") != NULL ? strtoul(getenv("OTHELLO_TT_MB"), NULL, 10) : TT_DEFAULT_MB, &tt_sharers);
+	else
+		tt_bytes = tt_init(getenv("OTHELLO_TT_MB") != NULL ? strtoul(getenv("OTHELLO_TT_MB"), NULL, 10) : TT_DEFAULT_MB);
+	// share of the distributed table each rank holds, OTHELLO_DTT_MB=0 turns it off. Not needed when one node table
+	// reaches every rank, and kept out of the offline modes, whose positions have different root players and it cannot be cleared
+	dtt_bytes = dtt_init((tt_sharers == size || offline) ? 0 : getenv("OTHELLO_DTT_MB") != NULL ? strtoul(getenv("OTHELLO_DTT_MB"), NULL, 10) : DTT_DEFAULT_MB);
+	// one rank per node with OTHELLO_THREADS set to the core count keeps every core busy
+	if (getenv("OTHELLO_THREADS") != NULL)
+		smp_threads = atoi(getenv("OTHELLO_THREADS"));
+	if (provided < MPI_THREAD_FUNNELED)
+		smp_threads = 1;
+	smp_init();
+	eg_init(search_timeout);
+	pattern_init(stabilityWeights2);
+	order_init(stabilityWeights2);
 	// double time = 0.0;
 	// clock_t begin = clock();
-	if (rank == 0)
+	if (argc > 1 && strcmp(argv[1], "--build-book") == 0)
+	{
+		build_book(argc, argv);
+	}
+	else if (argc > 1 && strcmp(argv[1], "--probcut-stats") == 0)
+	{
+		probcut_stats(argc, argv);
+	}
+	else if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+	{
+		status = bench(argc, argv);
+	}
+	else if (rank == 0)
 	{
 		run_master(argc, argv, fp);
 	}
@@ -148,6 +412,7 @@ int main(int argc, char *argv[])
 	// clock_t end = clock();
 	// time += (double)(end - begin) / CLOCKS_PER_SEC;
 	game_over();
+	return status;
 }
 
 void run_master(int argc, char *argv[], FILE *fp)
@@ -155,18 +420,55 @@ void run_master(int argc, char *argv[], FILE *fp)
 	char cmd[CMDBUFSIZE];
 	char my_move[MOVEBUFSIZE];
 	char opponent_move[MOVEBUFSIZE];
-	int time_limit;
+	double time_limit = 0;
 	int my_colour;
 	int running = 0;
+	bitboard_t saved_board;
 
 	if (initialise_master(argc, argv, &time_limit, &my_colour, &fp) != FAILURE)
 	{
 		running = 1;
+		fprintf(fp, "Transposition table %zu MB shared by %d ranks, %d threads per rank\n", tt_bytes >> 20, tt_sharers, smp_threads);
+		fprintf(fp, "Distributed table %zu MB per rank\n", dtt_bytes >> 20);
+		// only rank 0 reads the book, OTHELLO_BOOK overrides where it is
+		fprintf(fp, "Opening book %zu positions\n", book_open(getenv("OTHELLO_BOOK") != NULL ? getenv("OTHELLO_BOOK") : BOOK_DEFAULT_PATH));
 	}
 	if (my_colour == EMPTY)
 		my_colour = BLACK;
-	// Broadcast my_colour
+	// OTHELLO_DISPATCH=static restores the fixed round robin split of root moves
+	dispatch_mode = DISPATCH_DYNAMIC;
+	if (getenv("OTHELLO_DISPATCH") != NULL && strcmp(getenv("OTHELLO_DISPATCH"), "static") == 0)
+		dispatch_mode = DISPATCH_STATIC;
+	if (getenv("OTHELLO_ENDGAME") != NULL)
+		endgame_empties = atoi(getenv("OTHELLO_ENDGAME"));
+	// OTHELLO_EVAL=classic restores the three phase evaluation
+	eval_mode = EVAL_PATTERN;
+	if (getenv("OTHELLO_EVAL") != NULL && strcmp(getenv("OTHELLO_EVAL"), "classic") == 0)
+		eval_mode = EVAL_CLASSIC;
+	// OTHELLO_SEARCH=alphabeta restores full window alpha-beta
+	search_mode = SEARCH_PVS;
+	if (getenv("OTHELLO_SEARCH") != NULL && strcmp(getenv("OTHELLO_SEARCH"), "alphabeta") == 0)
+		search_mode = SEARCH_ALPHABETA;
+	// OTHELLO_PONDER=0 leaves the ranks idle while the opponent thinks
+	ponder.enabled = (getenv("OTHELLO_PONDER") == NULL || atoi(getenv("OTHELLO_PONDER")) != 0);
+	// ProbCut fits are made for one evaluation, OTHELLO_PROBCUT overrides where they are
+	if (running)
+	{
+		probcut_enabled = mpc_load(getenv("OTHELLO_PROBCUT") != NULL ? getenv("OTHELLO_PROBCUT") : MPC_DEFAULT_PATH, eval_mode);
+		fprintf(fp, "ProbCut %d fits\n", probcut_enabled);
+		probcut_enabled = (probcut_enabled > 0);
+	}
+
+	// Broadcast my_colour, time limit, dispatch mode, endgame threshold, evaluation, search and ProbCut fits
 	MPI_Bcast(&my_colour, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&time_limit, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&dispatch_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&endgame_empties, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&eval_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&search_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&probcut_enabled, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(mpc_fits, sizeof(mpc_fits), MPI_BYTE, 0, MPI_COMM_WORLD);
+	set_move_budget(time_limit);
 
 	while (running == 1)
 	{
@@ -191,11 +493,8 @@ void run_master(int argc, char *argv[], FILE *fp)
 		}
 		else if (strcmp(cmd, "gen_move") == 0)
 		{
-			// Broadcast running
-			MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-			// Broadcast board
-			MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD);
+			// Broadcast running and the position
+			sync_ranks(&running, &my_colour, fp);
 			gen_move_master(my_move, my_colour, fp);
 			print_board(fp);
 
@@ -206,6 +505,16 @@ void run_master(int argc, char *argv[], FILE *fp)
 				fflush(fp);
 				break;
 			}
+			saved_board = board;
+			if (ponder.enabled && ponder_predict(my_colour, fp) != -1)
+			{
+				// every rank searches our answer to the expected reply until the referee speaks
+				running = PONDER;
+				sync_ranks(&running, &my_colour, fp);
+				ponder_strategy(my_colour, fp);
+				board = saved_board;
+				running = 1;
+			}
 
 			/* Received opponent's move (play_move mesage) */
 		}
@@ -214,6 +523,13 @@ void run_master(int argc, char *argv[], FILE *fp)
 			apply_opp_move(opponent_move, my_colour, fp);
 			print_board(fp);
 
+			/* Received our own move, played for us (force_move message from tools/referee.c openings) */
+		}
+		else if (strcmp(cmd, "force_move") == 0)
+		{
+			make_move(get_loc(opponent_move), my_colour, fp);
+			print_board(fp);
+
 			/* Received unknown message */
 		}
 		else
@@ -223,10 +539,11 @@ void run_master(int argc, char *argv[], FILE *fp)
 	}
 	// Broadcast running
 
-	MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	sync_ranks(&running, &my_colour, fp);
+	mpiprof_report(fp);
 }
 
-int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, FILE **fp)
+int initialise_master(int argc, char *argv[], double *time_limit, int *my_colour, FILE **fp)
 {
 	int result = FAILURE;
 
@@ -234,7 +551,7 @@ int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, F
 	{
 		unsigned long ip = inet_addr(argv[1]);
 		int port = atoi(argv[2]);
-		*time_limit = atoi(argv[3]);
+		*time_limit = atof(argv[3]);
 
 		*fp = fopen(argv[4], "w");
 		if (*fp != NULL)
@@ -261,28 +578,7 @@ int initialise_master(int argc, char *argv[], int *time_limit, int *my_colour, F
 
 void initialise_board()
 {
-	int i;
-	board = (int *)malloc(BOARDSIZE * sizeof(int));
-	for (i = 0; i <= 9; i++)
-		board[i] = OUTER;
-	for (i = 10; i <= 89; i++)
-	{
-		if (i % 10 >= 1 && i % 10 <= 8)
-			board[i] = EMPTY;
-		else
-			board[i] = OUTER;
-	}
-	for (i = 90; i <= 99; i++)
-		board[i] = OUTER;
-	board[44] = WHITE;
-	board[45] = BLACK;
-	board[54] = BLACK;
-	board[55] = WHITE;
-}
-
-void free_board()
-{
-	free(board);
+	bb_init(&board);
 }
 
 /**
@@ -299,27 +595,548 @@ void run_worker(FILE *fp)
 	// int *buff=(int *)malloc(size * 2 * sizeof(int));;
 	// Broadcast colour
 	int my_colour;
+	double time_limit;
 	MPI_Bcast(&my_colour, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-	// Broadcast running
-	MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-	while (running == 1)
+	MPI_Bcast(&time_limit, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&dispatch_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&endgame_empties, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&eval_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&search_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(&probcut_enabled, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	MPI_Bcast(mpc_fits, sizeof(mpc_fits), MPI_BYTE, 0, MPI_COMM_WORLD);
+	set_move_budget(time_limit);
+
+	// Broadcast running and the position, the board stays ours between moves
+	sync_ranks(&running, &my_colour, fp);
+
+	while (running != 0)
 	{
-		// Broadcast board
-		MPI_Bcast(board, BOARDSIZE, MPI_INT, 0, MPI_COMM_WORLD);
-		// Generate move
-
-		gen_move_master(my_move, my_colour, fp);
+		// Generate move, or ponder on the opponent's time
+		if (running == PONDER)
+		{
+			ponder_strategy(my_colour, fp);
+		}
+		else
+		{
+			gen_move_master(my_move, my_colour, fp);
+		}
 		// loc = minimax_strategy(my_colour, fp, &best_val);
 		// send_arrMovesScore[0] = loc;
 		// send_arrMovesScore[1] = best_val;
 		//gen_move_master(my_move, my_colour, fp);
 		//minimax strategy
 
-		// Broadcast running
-		MPI_Bcast(&running, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		// Broadcast running and the next position
+		sync_ranks(&running, &my_colour, fp);
+	}
+	mpiprof_report(fp);
+}
+
+/**
+ * A position waiting to be booked, keyed for removing symmetric duplicates
+ */
+typedef struct
+{
+	uint64_t key;
+	bitboard_t board;
+	int side; //index into board.disc of the player to move
+	int ply;
+} book_position_t;
+
+static int book_position_order(const void *a, const void *b)
+{
+	uint64_t x = ((const book_position_t *)a)->key, y = ((const book_position_t *)b)->key;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief offline opening book builder, run on every rank as
+ * mpirun -np <n> player/my_player --build-book <file> <plies> <seconds>
+ * 
+ * Rank 0 lists every position up to plies moves from the start, one per
+ * symmetry class, and all ranks search each of them together for the given
+ * number of seconds, as they would in a game.
+ */
+void build_book(int argc, char *argv[])
+{
+	const char *path = (argc > 2) ? argv[2] : BOOK_DEFAULT_PATH;
+	int plies = (argc > 3) ? atoi(argv[3]) : 6;
+	double seconds = (argc > 4) ? atof(argv[4]) : 2.0;
+	book_position_t *list = NULL, *p;
+	book_entry_t *records = NULL;
+	long count = 0, level_start = 0, level_end, i, j;
+	int ply, sym, loc, colour, running = 1;
+	uint64_t moves, flips;
+	char move[MOVEBUFSIZE];
+
+	move_budget = seconds;
+	dispatch_mode = DISPATCH_DYNAMIC;
+	eval_mode = EVAL_PATTERN;
+	search_mode = SEARCH_PVS;
+	if (rank == 0)
+	{
+		list = (book_position_t *)malloc(sizeof(book_position_t));
+		bb_init(&list[0].board);
+		list[0].side = 0;
+		list[0].ply = 0;
+		count = 1;
+		for (ply = 1; ply <= plies; ply++)
+		{
+			// expand the previous level, then drop symmetric duplicates
+			level_end = count;
+			list = (book_position_t *)realloc(list, (count + (level_end - level_start) * SQUARES) * sizeof(book_position_t));
+			for (i = level_start; i < level_end; i++)
+			{
+				moves = bb_moves(list[i].board.disc[list[i].side], list[i].board.disc[!list[i].side]);
+				for (; moves; moves &= moves - 1)
+				{
+					loc = bb_first(moves);
+					p = &list[count++];
+					*p = list[i];
+					flips = bb_flips(loc, p->board.disc[p->side], p->board.disc[!p->side]);
+					p->board.disc[p->side] |= flips | SQ_BIT(loc);
+					p->board.disc[!p->side] &= ~flips;
+					p->side = !p->side;
+					p->ply = ply;
+					p->key = book_key(&p->board, p->side, &sym);
+				}
+			}
+			qsort(&list[level_end], count - level_end, sizeof(book_position_t), book_position_order);
+			for (i = j = level_end; i < count; i++)
+			{
+				if (j == level_end || list[i].key != list[j - 1].key)
+					list[j++] = list[i];
+			}
+			count = j;
+			level_start = level_end;
+		}
+		records = (book_entry_t *)calloc(count, sizeof(book_entry_t));
+		printf("Booking %ld positions up to %d plies, %.1f s each\n", count, plies, seconds);
+	}
+	MPI_Bcast(&count, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+	for (i = 0; i < count; i++)
+	{
+		if (rank == 0)
+		{
+			board = list[i].board;
+			colour = list[i].side + 1;
+		}
+		// scores are stored for the root player, who changes from position to position
+		tt_clear();
+		sync_ranks(&running, &colour, NULL);
+		gen_move_master(move, colour, NULL);
+		if (rank == 0)
+		{
+			records[i].key = book_key(&list[i].board, list[i].side, &sym);
+			records[i].plies = list[i].ply;
+			records[i].move = (strncmp(move, "pass", 4) == 0) ? -1 : book_square(get_loc(move), sym);
+			if ((i + 1) % 100 == 0)
+				printf("%ld/%ld\n", i + 1, count);
+		}
+	}
+	if (rank == 0)
+	{
+		// positions the side to move has to pass in are left out
+		for (i = j = 0; i < count; i++)
+		{
+			if (records[i].move != -1)
+				records[j++] = records[i];
+		}
+		if (book_write(path, records, j) == 0)
+			printf("Wrote %ld positions to %s\n", j, path);
+		else
+			fprintf(stderr, "Could not write %s\n", path);
+		free(list);
+		free(records);
+	}
+}
+
+/**
+ * @brief offline ProbCut calibration, run on every rank as
+ * mpirun -np <n> player/my_player --probcut-stats <file> <positions> <depth>
+ * 
+ * Each rank plays random openings of its share of the positions and searches
+ * each one to every depth up to the given one, without ProbCut. Rank 0 gathers
+ * the scores and fits every deep score against the shallow ones it may be
+ * predicted from, per disc count phase.
+ */
+void probcut_stats(int argc, char *argv[])
+{
+	const char *path = (argc > 2) ? argv[2] : MPC_DEFAULT_PATH;
+	int positions = (argc > 3) ? atoi(argv[3]) : 200;
+	int max_depth = (argc > 4) ? atoi(argv[4]) : 8;
+	int width; //disc count then the score of each depth
+	int count = 0, total = 0, i, d, s, n, ply, plies, colour, phase, loc, valid;
+	int moves[SQUARES + 1], shallow[MPC_MAXSHALLOW];
+	int *counts = NULL, *displs = NULL;
+	double *samples, *all = NULL, *xs = NULL, *ys = NULL;
+	unsigned int seed;
+
+	if (max_depth > MPC_MAXDEPTH)
+		max_depth = MPC_MAXDEPTH;
+	width = max_depth + 1;
+	dispatch_mode = DISPATCH_STATIC;
+	eval_mode = EVAL_PATTERN;
+	search_mode = SEARCH_PVS;
+	probcut_enabled = 0;
+	samples = (double *)malloc(((positions + size - 1) / size) * width * sizeof(double));
+	for (i = rank; i < positions; i += size)
+	{
+		// a random opening of 6 to 46 plies, seeded by the position so runs repeat
+		seed = (unsigned int)i * 2654435761u + 1;
+		plies = 6 + rand_r(&seed) % 41;
+		initialise_board();
+		colour = BLACK;
+		for (ply = 0; ply < plies; ply++)
+		{
+			legal_moves(colour, moves, NULL);
+			if (moves[0] > 0)
+				make_move(moves[rand_r(&seed) % moves[0] + 1], colour, NULL);
+			else if (bb_moves(DISCS(colour == BLACK ? WHITE : BLACK), DISCS(colour)) == 0)
+				break; //game over
+			colour = (colour == BLACK) ? WHITE : BLACK;
+		}
+		legal_moves(colour, moves, NULL);
+		if (moves[0] <= 0)
+			continue;
+
+		tt_clear();
+		board_hash = tt_hash(&board);
+		features_init();
+		search_deadline = MPI_Wtime() + 1e9;
+		search_stopped = 0;
+		root_bound = MIN;
+		solve_window = 0;
+		valid = 1;
+		samples[count * width] = bb_count(board.disc[0] | board.disc[1]);
+		for (d = 1; d <= max_depth && valid; d++)
+		{
+			search_depth = d;
+			samples[count * width + d] = minimax_score(0, 0, colour, NULL, MIN, MAX);
+			valid = fabs(samples[count * width + d]) < WIN_WEIGHT; //solved scores would skew the fit
+		}
+		count += valid;
+	}
+
+	// rank 0 collects every rank's samples
+	if (rank == 0)
+	{
+		counts = (int *)malloc(size * sizeof(int));
+		displs = (int *)malloc(size * sizeof(int));
+	}
+	n = count * width;
+	MPI_Gather(&n, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	if (rank == 0)
+	{
+		for (i = 0; i < size; i++)
+		{
+			displs[i] = total;
+			total += counts[i];
+		}
+		all = (double *)malloc((total > 0 ? total : 1) * sizeof(double));
+	}
+	MPI_Gatherv(samples, n, MPI_DOUBLE, all, counts, displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	if (rank == 0)
+	{
+		total /= width;
+		xs = (double *)malloc((total > 0 ? total : 1) * sizeof(double));
+		ys = (double *)malloc((total > 0 ? total : 1) * sizeof(double));
+		memset(mpc_fits, 0, sizeof(mpc_fits));
+		for (phase = 0; phase < MPC_PHASES; phase++)
+		{
+			for (d = MPC_MINDEPTH; d <= max_depth; d++)
+			{
+				for (loc = 0; loc < mpc_shallow(d, shallow); loc++)
+				{
+					s = shallow[loc];
+					for (i = n = 0; i < total; i++)
+					{
+						if (mpc_phase((int)all[i * width]) == phase)
+						{
+							xs[n] = all[i * width + s];
+							ys[n] = all[i * width + d];
+							n++;
+						}
+					}
+					mpc_fit(&mpc_fits[phase][d][s], xs, ys, n);
+					if (mpc_fits[phase][d][s].sigma > 0)
+						printf("phase %d depth %d from %d: a %.3f b %.1f sigma %.1f (%d positions)\n", phase, d, s,
+							   mpc_fits[phase][d][s].a, mpc_fits[phase][d][s].b, mpc_fits[phase][d][s].sigma, n);
+				}
+			}
+		}
+		if (mpc_save(path, eval_mode) == 0)
+			printf("Wrote fits from %d positions to %s\n", total, path);
+		else
+			fprintf(stderr, "Could not write %s\n", path);
+		free(counts);
+		free(displs);
+		free(all);
+		free(xs);
+		free(ys);
+	}
+	free(samples);
+}
+
+/**
+ * Fixed positions the benchmark runs on: the start and random games at 16 to
+ * 48 discs. Changing them makes results incomparable with earlier builds
+ */
+const uint64_t bench_positions[][3] = {
+	{0x0000000810000000ULL, 0x0000001008000000ULL, 1}, //start
+	{0x00004028500a0000ULL, 0x0000201028642200ULL, 1},
+	{0x0020100604001404ULL, 0x10144838183f0000ULL, 1},
+	{0x702032242c002020ULL, 0x070a0c18123c4880ULL, 1},
+	{0x607838fc02808202ULL, 0x00000102fd7f2448ULL, 1},
+	{0x0000091f071f2f04ULL, 0xfcf9f6e0b8800001ULL, 1},
+};
+#define BENCH_POSITIONS (int)(sizeof(bench_positions) / sizeof(bench_positions[0]))
+#define BENCH_EVALS 200000 //evaluations timed per position and evaluator
+
+/**
+ * @brief counts the leaves of the move tree below the global board with
+ * legal_moves, make_move and unmake_move, as the search walks it. A pass is a
+ * move and a finished game a leaf
+ * 
+ * @param depth plies left
+ * @param player colour to move
+ * @param fp file
+ * @return long leaves
+ */
+long perft(int depth, int player, FILE *fp)
+{
+	int *moves = search_stack[depth].moves;
+	long leaves = 0;
+	uint64_t flips;
+	int i;
+
+	if (depth == 0)
+		return 1;
+	legal_moves(player, moves, fp);
+	if (moves[0] <= 0)
+	{
+		if (bb_moves(DISCS(opponent(player, fp)), DISCS(player)) == 0)
+			return 1; //game over
+		return perft(depth - 1, opponent(player, fp), fp);
+	}
+	for (i = 1; i <= moves[0]; i++)
+	{
+		flips = make_move(moves[i], player, fp);
+		leaves += perft(depth - 1, player == BLACK ? WHITE : BLACK, fp);
+		unmake_move(moves[i], flips, player, fp);
+	}
+	return leaves;
+}
+
+/**
+ * @brief reads a depth given on the command line, clamped to 1..SQUARES, the
+ * deepest the search stack reaches
+ *
+ * @param arg argument
+ * @return int depth, 0 if arg is not a number
+ */
+int depth_arg(const char *arg)
+{
+	char *end;
+	long depth = strtol(arg, &end, 10);
+
+	if (end == arg || *end != '\0')
+		return 0;
+	if (depth < 1)
+		depth = 1;
+	if (depth > SQUARES)
+		depth = SQUARES;
+	return (int)depth;
+}
+
+/**
+ * @brief bytes of the heap in use, 0 where the C library cannot tell
+ *
+ * @return size_t bytes
+ */
+size_t heap_in_use()
+{
+#ifdef __GLIBC__
+	return mallinfo2().uordblks;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief checks that search iterations in both dispatch modes leave the heap
+ * as they found it, run by every rank. Each mode searches the fixed positions
+ * to the given depth with search_iteration as minimax_strategy does, the heap
+ * measured around every iteration, so the collectives between iterations,
+ * which MPI may allocate for, are left out. The first position is searched
+ * once before it is counted
+ *
+ * @param depth last iteration
+ * @return int dispatch modes in which the heap of some rank grew
+ */
+int bench_heap(int depth)
+{
+	int modes[2] = {DISPATCH_STATIC, DISPATCH_DYNAMIC};
+	const char *mode_names[2] = {"static", "dynamic"};
+	long grown, max_grown;
+	size_t before;
+	int i, m, d, p, colour, score, failed = 0;
+
+	for (m = 0; m < 2; m++)
+	{
+		dispatch_mode = modes[m];
+		grown = 0;
+		for (i = -1; i < BENCH_POSITIONS; i++)
+		{
+			p = (i < 0) ? 0 : i;
+			board.disc[0] = bench_positions[p][0];
+			board.disc[1] = bench_positions[p][1];
+			colour = (int)bench_positions[p][2];
+			tt_clear();
+			search_serial++;
+			board_hash = tt_hash(&board);
+			features_init();
+			if (dispatch_mode == DISPATCH_STATIC)
+				rank_legal_moves(colour, search_stack[0].moves, NULL);
+			else if (rank == 0)
+			{
+				legal_moves(colour, root_queue.moves, NULL);
+				memset(root_queue.cost, 0, sizeof(root_queue.cost));
+			}
+			search_deadline = MPI_Wtime() + 1e9;
+			search_stopped = 0;
+			for (d = 1; d <= depth; d++)
+			{
+				search_depth = d;
+				bound_serial++;
+				root_bound = MIN;
+				solve_window = 0;
+				aspiration_low = MIN;
+				aspiration_high = MAX;
+				before = heap_in_use();
+				search_iteration(colour, &score, NULL);
+				if (i >= 0 && heap_in_use() > before)
+					grown += (long)(heap_in_use() - before);
+				MPI_Barrier(MPI_COMM_WORLD); //the ranks start each iteration together, as after minimax_strategy's reduction
+			}
+		}
+		MPI_Reduce(&grown, &max_grown, 1, MPI_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+		if (rank == 0)
+			printf("heap mode=%s positions=%d depth=%d grown=%ld\n", mode_names[m], BENCH_POSITIONS, depth, max_grown);
+		failed += (rank == 0 && max_grown > 0);
+	}
+	dispatch_mode = DISPATCH_STATIC;
+	return failed;
+}
+
+/**
+ * @brief micro-benchmark, run as
+ * player/my_player --bench [perft depth] [search depth]
+ * 
+ * Every rank first takes part in the heap check of both dispatch modes, then
+ * rank 0 times perft, a fixed depth search from an empty table and both
+ * evaluators on the fixed positions. Prints one line of key=value pairs per
+ * measurement and a total line, node counts and checksums only change with
+ * the engine's behaviour, the rates with its speed.
+ *
+ * @return int 0 if the searches left the heap alone, else the checks that failed
+ */
+int bench(int argc, char *argv[])
+{
+	int perft_depth = (argc > 2) ? depth_arg(argv[2]) : 6;
+	int depth = (argc > 3) ? depth_arg(argv[3]) : 11;
+	int modes[2] = {EVAL_CLASSIC, EVAL_PATTERN};
+	const char *mode_names[2] = {"classic", "pattern"};
+	long nodes, total_nodes = 0, evals, checksum, grown = 0;
+	double begin, seconds, total_seconds = 0;
+	int i, m, n, d, colour, score = 0, failed;
+	size_t before;
+	volatile int side; //read on every evaluation, so the calls cannot be hoisted out of the loop
+
+	if (perft_depth == 0 || depth == 0)
+	{
+		if (rank == 0)
+			fprintf(stderr, "Usage: player/my_player --bench [perft depth] [search depth]\n");
+		return 1;
+	}
+	eval_mode = EVAL_PATTERN;
+	search_mode = SEARCH_PVS;
+	probcut_enabled = 0;
+	failed = bench_heap(depth);
+	if (rank != 0)
+		return 0;
+
+	for (i = 0; i < BENCH_POSITIONS; i++)
+	{
+		board.disc[0] = bench_positions[i][0];
+		board.disc[1] = bench_positions[i][1];
+		colour = (int)bench_positions[i][2];
+		board_hash = tt_hash(&board);
+		features_init();
+		begin = MPI_Wtime();
+		nodes = perft(perft_depth, colour, NULL);
+		seconds = MPI_Wtime() - begin;
+		total_nodes += nodes;
+		total_seconds += seconds;
+		printf("perft position=%d depth=%d nodes=%ld seconds=%.3f nps=%.0f\n", i, perft_depth, nodes, seconds,
+			   nodes / (seconds > 0 ? seconds : 1e-9));
+	}
+
+	for (i = 0; i < BENCH_POSITIONS; i++)
+	{
+		board.disc[0] = bench_positions[i][0];
+		board.disc[1] = bench_positions[i][1];
+		colour = (int)bench_positions[i][2];
+		tt_clear();
+		board_hash = tt_hash(&board);
+		features_init();
+		search_deadline = MPI_Wtime() + 1e9;
+		search_stopped = 0;
+		search_nodes = 0;
+		root_bound = MIN;
+		solve_window = 0;
+		before = heap_in_use();
+		begin = MPI_Wtime();
+		for (d = 1; d <= depth; d++)
+		{
+			search_depth = d;
+			score = minimax_score(0, 0, colour, NULL, MIN, MAX);
+		}
+		seconds = MPI_Wtime() - begin;
+		if (heap_in_use() > before)
+			grown += (long)(heap_in_use() - before);
+		total_nodes += search_nodes;
+		total_seconds += seconds;
+		printf("search position=%d depth=%d nodes=%ld score=%d seconds=%.3f nps=%.0f\n", i, depth, search_nodes, score,
+			   seconds, search_nodes / (seconds > 0 ? seconds : 1e-9));
+	}
+	printf("heap mode=serial positions=%d depth=%d grown=%ld\n", BENCH_POSITIONS, depth, grown);
+	failed += (grown > 0);
+
+	for (m = 0; m < 2; m++)
+	{
+		eval_mode = modes[m];
+		evals = checksum = 0;
+		seconds = 0;
+		for (i = 0; i < BENCH_POSITIONS; i++)
+		{
+			board.disc[0] = bench_positions[i][0];
+			board.disc[1] = bench_positions[i][1];
+			side = (int)bench_positions[i][2];
+			features_init();
+			begin = MPI_Wtime();
+			for (n = 0; n < BENCH_EVALS; n++)
+				checksum += evaluatePosition(side, NULL);
+			seconds += MPI_Wtime() - begin;
+			evals += BENCH_EVALS;
+		}
+		total_seconds += seconds;
+		printf("eval mode=%s evals=%ld checksum=%ld seconds=%.3f eps=%.0f\n", mode_names[m], evals, checksum, seconds,
+			   evals / (seconds > 0 ? seconds : 1e-9));
 	}
+	printf("total nodes=%ld seconds=%.3f nps=%.0f\n", total_nodes, total_seconds, total_nodes / (total_seconds > 0 ? total_seconds : 1e-9));
+	return failed;
 }
 
 /**
@@ -333,23 +1150,39 @@ void run_worker(FILE *fp)
 void gen_move_master(char *move, int my_colour, FILE *fp)
 {
 	int loc;
-	int *buff = (int *)malloc(size * 2 * sizeof(int));
+	move_record_t *records = NULL;
 	/* generate move */
 	// loc = location_strategy(my_colour, fp); //random_strategy
 	best_val = MIN;
-	//dlegate legal moves to all proccesses
+	memset(&move_record, 0, sizeof(move_record));
+	mpiprof_move_begin();
+	// rank 0 looked the position up in the book in sync_ranks
+	loc = book_move;
 
-	loc = minimax_strategy(my_colour, fp);
+	//dlegate legal moves to all proccesses
+	if (loc == -1)
+	{
+		loc = minimax_strategy(my_colour, fp);
+	}
+	else
+	{
+		best_val = 0; //book move, the time saved is left unused
+		if (rank == 0)
+			fprintf(fp, "Book move %d\n", loc);
+	}
 
-	send_arrMovesScore[0] = loc;
-	send_arrMovesScore[1] = best_val;
+	move_record.loc = loc;
+	move_record.score = best_val;
 
 	if (rank == 0)
 	{
-		MPI_Gather(send_arrMovesScore, 2, MPI_INT, buff, 2, MPI_INT, 0, MPI_COMM_WORLD); //gathers (receive) move and score
-		loc = get_best_loc(buff);
+		records = (move_record_t *)malloc(size * sizeof(move_record_t));
+		MPI_Gather(&move_record, MOVERECORDSIZE, MPI_DOUBLE, records, MOVERECORDSIZE, MPI_DOUBLE, 0, MPI_COMM_WORLD); //gathers (receive) move, score and stats
+		loc = get_best_loc(records);
 		// Debug("best loc %d", loc);														 //get best loc
-		free(buff);
+		if (fp != NULL)
+			log_move_stats(records, loc, fp);
+		free(records);
 
 		if (loc == -1)
 		{
@@ -364,30 +1197,111 @@ void gen_move_master(char *move, int my_colour, FILE *fp)
 	}
 	else
 	{
-		MPI_Gather(send_arrMovesScore, 2, MPI_INT, NULL, 0, MPI_INT, 0, MPI_COMM_WORLD); //Gathers(sends) move and score
+		MPI_Gather(&move_record, MOVERECORDSIZE, MPI_DOUBLE, NULL, 0, MPI_DOUBLE, 0, MPI_COMM_WORLD); //Gathers(sends) move, score and stats
 	}
+	mpiprof_move_end();
 }
 /**
- * @brief Get the best loc object given in as array of 2
+ * @brief Get the best loc object given in as array of records
  * 
- * @param buff array of length 2
+ * @param records one record per rank
  * @return int returns best location of move
  */
 
-int get_best_loc(int *buff)
+int get_best_loc(move_record_t *records)
 {
 	int best_loc = -1;
 	int best_value = MIN;
 	for (int i = 0; i < size; i++)
 	{
-		if (buff[i * 2 + 1] > best_value)
+		if (records[i].score > best_value)
 		{
-			best_value = buff[i * 2 + 1];
-			best_loc = buff[i * 2];
+			best_value = (int)records[i].score;
+			best_loc = (int)records[i].loc;
 		}
 	}
 	return best_loc;
 }
+/**
+ * @brief writes one line of key=value pairs for the move: totals over the
+ * ranks, the effective branching factor of the last iteration, and each
+ * rank's nodes and share of the time it was busy
+ * 
+ * @param records one record per rank
+ * @param loc move played
+ * @param fp file
+ */
+void log_move_stats(move_record_t *records, int loc, FILE *fp)
+{
+	static int move_number;
+	double nodes = 0, leaves = 0, cutoffs = 0, first = 0, last = 0, before = 0, score = MIN;
+	double dtt_probes = 0, dtt_hits = 0;
+	double seconds = records[0].seconds;
+	int i;
+
+	for (i = 0; i < size; i++)
+	{
+		score = (records[i].score > score) ? records[i].score : score;
+		nodes += records[i].nodes;
+		leaves += records[i].leaves;
+		cutoffs += records[i].cutoffs;
+		first += records[i].first;
+		last += records[i].iter_nodes[0];
+		before += records[i].iter_nodes[1];
+		dtt_probes += records[i].dtt_probes;
+		dtt_hits += records[i].dtt_hits;
+	}
+	fprintf(fp, "Stats move=%d loc=%d depth=%d score=%d nodes=%.0f leaves=%.0f cutoffs=%.0f first=%.3f ebf=%.2f seconds=%.3f nps=%.0f",
+			++move_number, loc, (int)records[0].depth, (int)score, nodes, leaves, cutoffs, (cutoffs > 0) ? first / cutoffs : 0.0,
+			(before > 0) ? last / before : 0.0, seconds, (seconds > 0) ? nodes / seconds : 0.0);
+	fprintf(fp, " dtt_probes=%.0f dtt_hits=%.0f", dtt_probes, dtt_hits);
+	fprintf(fp, " rank_nodes=");
+	for (i = 0; i < size; i++)
+		fprintf(fp, "%s%.0f", i ? "," : "", records[i].nodes);
+	fprintf(fp, " rank_busy=");
+	for (i = 0; i < size; i++)
+		fprintf(fp, "%s%.2f", i ? "," : "", (records[i].seconds > 0) ? records[i].busy / records[i].seconds : 0.0);
+	fprintf(fp, "\n");
+	fflush(fp);
+}
+/**
+ * @brief starts every rank on the same search. Rank 0 sends whether to search,
+ * its position and the player to move, probing the book for a move search,
+ * the others take them over in place of their own
+ *
+ * @param running in on rank 0, set on the others: 0 to stop, 1 for a move, PONDER
+ * @param colour in on rank 0, set on the others: player to move
+ * @param fp file
+ */
+void sync_ranks(int *running, int *colour, FILE *fp)
+{
+	sync_msg_t msg;
+	int loc = -1;
+
+	if (rank == 0)
+	{
+		if (*running == 1)
+		{
+			loc = book_probe(&board, *colour - 1);
+			if (loc != -1 && !legalp(loc, *colour, fp))
+			{
+				loc = -1; //hash collision
+			}
+		}
+		msg.disc[0] = board.disc[0];
+		msg.disc[1] = board.disc[1];
+		msg.running = *running;
+		msg.colour = *colour;
+		msg.book_move = loc + 1;
+	}
+	MPI_Bcast(&msg, SYNCMSGSIZE, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+	board.disc[0] = msg.disc[0];
+	board.disc[1] = msg.disc[1];
+	*running = (int)msg.running;
+	*colour = (int)msg.colour;
+	book_move = (int)msg.book_move - 1;
+}
+
 void apply_opp_move(char *move, int my_colour, FILE *fp)
 {
 	int loc;
@@ -401,18 +1315,20 @@ void apply_opp_move(char *move, int my_colour, FILE *fp)
 
 void game_over()
 {
-	free_board();
+	smp_free();
+	book_close();
+	tt_free();
+	nodett_free();
+	dtt_free();
+	free(parked_ranks);
+	bound_free();
 	MPI_Finalize();
 }
 
 void get_move_string(int loc, char *ms)
 {
-	int row, col, new_loc;
-	new_loc = loc - (9 + 2 * (loc / 10));
-	row = new_loc / 8;
-	col = new_loc % 8;
-	ms[0] = row + '0';
-	ms[1] = col + '0';
+	ms[0] = SQ_ROW(loc) + '0';
+	ms[1] = SQ_COL(loc) + '0';
 	ms[2] = '\n';
 	ms[3] = 0;
 }
@@ -423,21 +1339,20 @@ int get_loc(char *movestring)
 	/* movestring of form "xy", x = row and y = column */
 	row = movestring[0] - '0';
 	col = movestring[1] - '0';
-	return (10 * (row + 1)) + col + 1;
+	return row * 8 + col;
 }
 
 void legal_moves(int player, int *moves, FILE *fp)
 {
-	int move, i;
-	moves[0] = 0;
+	uint64_t mask;
+	int i;
+	mask = bb_moves(DISCS(player), DISCS(opponent(player, fp)));
 	i = 0;
-	for (move = 11; move <= 88; move++)
+	while (mask)
 	{
-		if (legalp(move, player, fp))
-		{
-			i++;
-			moves[i] = move;
-		}
+		i++;
+		moves[i] = bb_first(mask);
+		mask &= mask - 1;
 	}
 	moves[0] = i;
 	// sortMoves(moves);
@@ -445,52 +1360,20 @@ void legal_moves(int player, int *moves, FILE *fp)
 
 int legalp(int move, int player, FILE *fp)
 {
-	int i;
 	if (!validp(move))
 		return 0;
-	if (board[move] == EMPTY)
-	{
-		i = 0;
-		while (i <= 7 && !would_flip(move, ALLDIRECTIONS[i], player, fp))
-			i++;
-		if (i == 8)
-			return 0;
-		else
-			return 1;
-	}
-	else
-		return 0;
+	return (bb_moves(DISCS(player), DISCS(opponent(player, fp))) & SQ_BIT(move)) != 0;
 }
 
 int validp(int move)
 {
-	if ((move >= 11) && (move <= 88) && (move % 10 >= 1) && (move % 10 <= 8))
+	if ((move >= 0) && (move < SQUARES))
 		return 1;
 	else
 		return 0;
 }
 
-int would_flip(int move, int dir, int player, FILE *fp)
-{
-	int c;
-	c = move + dir;
-	if (board[c] == opponent(player, fp))
-		return find_bracket_piece(c + dir, dir, player, fp);
-	else
-		return 0;
-}
-
-int find_bracket_piece(int square, int dir, int player, FILE *fp)
-{
-	while (board[square] == opponent(player, fp))
-		square = square + dir;
-	if (board[square] == player)
-		return square;
-	else
-		return 0;
-}
-
-int opponent(int player, FILE *fp)
+int opponent(int player, FILE *fp)
 {
 	if (player == BLACK)
 		return WHITE;
@@ -503,8 +1386,7 @@ int opponent(int player, FILE *fp)
 int random_strategy(int my_colour, FILE *fp)
 {
 	int r;
-	int *moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	memset(moves, 0, LEGALMOVSBUFSIZE);
+	int moves[LEGALMOVSBUFSIZE];
 
 	legal_moves(my_colour, moves, fp);
 	if (moves[0] == 0)
@@ -513,15 +1395,13 @@ int random_strategy(int my_colour, FILE *fp)
 	}
 	srand(time(NULL));
 	r = moves[(rand() % moves[0]) + 1];
-	free(moves);
 	return (r);
 }
 
 int location_strategy(int my_colour, FILE *fp) //initial strategy
 {
 	int r;
-	int *moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	memset(moves, 0, LEGALMOVSBUFSIZE);
+	int moves[LEGALMOVSBUFSIZE];
 
 	legal_moves(my_colour, moves, fp);
 	if (moves[0] == 0)
@@ -531,31 +1411,24 @@ int location_strategy(int my_colour, FILE *fp) //initial strategy
 	int best_loc;
 	srand(time(NULL));
 	best_loc = find_highestPos(moves);
-	int cnt, i, j;
+	int cnt, i;
 	for (i = 1; i <= moves[0]; i++)
 	{
-		for (j = 0; j < 8; j++)
-		{
-			cnt = would_flip(moves[i], ALLDIRECTIONS[j], my_colour, fp);
-			fprintf(fp, "my_c=%d move=%d would flip=%d in dir %d\n", my_colour, moves[i], cnt, ALLDIRECTIONS[j]);
-		}
+		cnt = bb_count(bb_flips(moves[i], DISCS(my_colour), DISCS(opponent(my_colour, fp))));
+		fprintf(fp, "my_c=%d move=%d would flip=%d\n", my_colour, moves[i], cnt);
 	}
 
 	r = moves[best_loc];
 
-	free(moves);
 	return (r);
 }
 int find_highestPos(int *moves) //only for location strategy
 {
-	int x, y;
 	int max = -21;
 	int max_i = 0;
 	for (int i = 1; i <= moves[0]; i++)
 	{
-		x = moves[i] / 10;
-		y = moves[i] % 10;
-		int val = stabilityWeights2[x - 1][y - 1];
+		int val = stabilityWeights2[SQ_ROW(moves[i])][SQ_COL(moves[i])];
 		if (val > max)
 		{
 			max = val;
@@ -565,39 +1438,20 @@ int find_highestPos(int *moves) //only for location strategy
 	return max_i;
 }
 /**
- * @brief sorts moves based off stability to speed up pruning
+ * @brief rotates the siblings after the first move, so each Lazy SMP helper
+ * thread searches them in a different order. The first move stays in front
  * 
- * @param moves given moves array
+ * @param moves ordered moves, count in moves[0]
+ * @param by places to rotate by, the helper's thread id
  */
-void sortMoves(int *moves) //based on stability
+void rotateMoves(int *moves, int by)
 {
-	int *movesValues = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	movesValues[0] = 0;
-	int x, y;
-	for (int i = 1; i <= moves[0]; i++)
-	{
-		x = moves[i] / 10;
-		y = moves[i] % 10;
-		int val = (stabilityWeights2[x - 1][y - 1]);
-		movesValues[i] = val;
-	} //add move values to array
+	int rotated[SQUARES];
+	int n = moves[0] - 1;
 
-	for (int i = 1; i <= moves[0]; ++i)
-	{
-		for (int j = i + 1; j <= moves[0]; ++j)
-		{
-			if (movesValues[i] < movesValues[j])
-			{
-				int tempValue = movesValues[i];
-				int tempMove = moves[i];
-				movesValues[i] = movesValues[j];
-				moves[i] = moves[j];
-				movesValues[j] = tempValue;
-				moves[j] = tempMove;
-			}
-		}
-	}
-	free(movesValues);
+	for (int i = 0; i < n; i++)
+		rotated[i] = moves[2 + (i + by) % n];
+	memcpy(&moves[2], rotated, n * sizeof(int));
 }
 /**
  * @brief moves for each rank that assigned and returned as pointer rank_moves
@@ -608,10 +1462,10 @@ void sortMoves(int *moves) //based on stability
  */
 void rank_legal_moves(int my_colour, int *rank_moves, FILE *fp)
 {
-	int *moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	memset(moves, 0, LEGALMOVSBUFSIZE);
+	int moves[LEGALMOVSBUFSIZE];
 	legal_moves(my_colour, moves, fp);
 	int counter = 0;
+	rank_moves[0] = 0;
 	if (moves[0] != 0)
 	{
 		for (int i = rank + 1; i <= moves[0]; i += size)
@@ -632,59 +1486,947 @@ void rank_legal_moves(int my_colour, int *rank_moves, FILE *fp)
 		}
 	}
 
-	// Debug("rank move %d for rank %d", rank_moves[0], rank);
-	free(moves);
+	// Debug("rank move %d for rank %d", rank_moves[0], rank);
+}
+/**
+ * @brief decides best strategy move for player based on the best minimax score,
+ * deepening one ply at a time until the move budget runs out
+ * 
+ * Every rank runs the same iterations and agrees after each one whether it
+ * completed and whether the next one fits in the budget, so all ranks return
+ * results of the same depth and reach MPI_Gather together.
+ * 
+ * Close to the end the second iteration solves the game instead, exactly or
+ * just win/loss/draw a little earlier, with the first one as the fallback.
+ * 
+ * @param my_colour players colour
+ * @param fp file
+ * @return int best move of the last completed iteration
+ */
+
+int minimax_strategy(int my_colour, FILE *fp)
+{
+	int depth, best_score, best_move = -1, iter_move;
+	int last_score = 0, widened = 0, first_depth = 1, done;
+	long iter_nodes;
+	double start, iter_start, iter_time, last_iter_time = 0, growth;
+	double local[3], global[3];
+	int *moves = search_stack[0].moves;
+	MPI_Request request;
+	// every rank pondered the same position, so they all agree on a hit
+	int resume = !ponder.pondering && ponder.depth > 0 &&
+				 ponder.board.disc[0] == board.disc[0] && ponder.board.disc[1] == board.disc[1];
+	search_serial++;
+	board_hash = tt_hash(&board);
+	features_init();
+	if (resume)
+	{
+		first_depth = ponder.solved ? MAXDEPTH + 1 : ponder.depth + 1;
+		best_move = ponder.best_move;
+		best_val = ponder.best_val;
+		last_score = ponder.last_score;
+		move_record.depth = ponder.depth;
+		if (rank == 0 && fp != NULL)
+			fprintf(fp, "Ponder hit, resuming after depth %d\n", ponder.depth);
+	}
+	else
+	{
+		tt_new_search(); //a hit keeps what the ponder search stored current
+	}
+	ponder.depth = 0;
+	order_reset_stats();
+	dtt_reset_stats();
+	int empties = SQUARES - bb_count(board.disc[0] | board.disc[1]);
+	//get moves from get proc legal moves instead of legal moves
+	if (dispatch_mode == DISPATCH_STATIC)
+	{
+		rank_legal_moves(my_colour, moves, fp);
+	}
+	else if (rank == 0)
+	{
+		legal_moves(my_colour, root_queue.moves, fp);
+		if (!resume)
+			memset(root_queue.cost, 0, sizeof(root_queue.cost));
+	}
+	//legal_moves(my_colour, moves, fp);
+	// Debug("move %d for rank %d", moves[0], rank);
+
+	start = MPI_Wtime();
+	search_deadline = start + (ponder.pondering ? 1e9 : move_budget); //a ponder runs until the referee speaks
+	search_stopped = 0;
+	search_nodes = 0;
+	search_leaves = 0;
+	smp_nodes = smp_leaves = 0;
+	busy_seconds = 0;
+	move_record.iter_nodes[0] = move_record.iter_nodes[1] = 0;
+	for (depth = first_depth; depth <= MAXDEPTH && depth <= empties; depth++)
+	{
+		search_depth = depth;
+		iter_nodes = search_nodes + smp_nodes;
+		bound_serial++; //every rank runs the same iterations, so the tags agree
+		root_bound = MIN;
+		solve_window = 0;
+		if (depth > 1 && endgame_empties > 0 && empties <= endgame_empties + EG_WLD_EXTRA)
+		{
+			solve_window = (empties <= endgame_empties) ? EG_EXACT : EG_WLD;
+		}
+		// centre the root window on the last score, opened again if every move fails low
+		aspiration_low = MIN;
+		aspiration_high = MAX;
+		if (search_mode == SEARCH_PVS && depth > 1 && solve_window == 0 && !widened)
+		{
+			aspiration_low = last_score - ASPIRATION_WINDOW;
+			aspiration_high = last_score + ASPIRATION_WINDOW;
+		}
+		widened = 0;
+		iter_start = MPI_Wtime();
+		iter_move = search_iteration(my_colour, &best_score, fp);
+
+		// predict the next iteration from how much this one grew
+		iter_time = MPI_Wtime() - iter_start;
+		growth = (last_iter_time > 0.001) ? iter_time / last_iter_time : 4.0;
+		growth = (growth < 2.0) ? 2.0 : (growth > 10.0) ? 10.0 : growth;
+		last_iter_time = iter_time;
+
+		local[0] = search_stopped;
+		local[1] = (MPI_Wtime() - start) + iter_time * growth;
+		local[2] = best_score;
+		// rank 0 keeps watching the clock and the referee while slower ranks finish
+		MPI_Iallreduce(local, global, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD, &request);
+		do
+		{
+			stop_check();
+			MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+		} while (!done);
+		if (global[0] != 0)
+		{
+			// stopped, keep the previous iteration unless this one got far enough to beat it
+			if (dispatch_mode == DISPATCH_DYNAMIC && rank == 0 && !ponder.pondering && partial_iteration(best_move, best_score))
+			{
+				if (fp != NULL && iter_move != best_move)
+					fprintf(fp, "Stopped in depth %d, its move %d replaces %d\n", depth, iter_move, best_move);
+				best_move = iter_move;
+				best_val = best_score;
+			}
+			break;
+		}
+		if (global[2] <= aspiration_low && aspiration_low > MIN)
+		{
+			widened = 1; //the score dropped out of the window, search this depth again
+			depth--;
+			continue;
+		}
+		last_score = global[2];
+		best_move = iter_move;
+		best_val = best_score;
+		move_record.depth = depth;
+		move_record.iter_nodes[1] = move_record.iter_nodes[0];
+		move_record.iter_nodes[0] = search_nodes + smp_nodes - iter_nodes;
+		if (ponder.pondering)
+		{
+			ponder.depth = depth;
+			ponder.solved = (solve_window != 0);
+			ponder.best_move = best_move;
+			ponder.best_val = best_val;
+			ponder.last_score = last_score;
+		}
+		if (solve_window != 0)
+		{
+			break; //solved, deeper heuristic iterations cannot improve on it
+		}
+		if (global[1] > move_budget && !ponder.pondering)
+		{
+			break; //next iteration would overrun
+		}
+	}
+	// fprintf(fp, "bestie score=%d at %d\n", best_val, best_move);
+	order_stats_t stats = order_stats();
+	move_record.nodes = search_nodes + smp_nodes;
+	move_record.leaves = search_leaves + smp_leaves;
+	move_record.cutoffs = stats.cutoffs;
+	move_record.first = stats.first;
+	move_record.seconds = MPI_Wtime() - start;
+	move_record.busy = busy_seconds;
+	dtt_flush();
+	move_record.dtt_probes = dtt_stats().probes;
+	move_record.dtt_hits = dtt_stats().hits;
+	return best_move;
+}
+/**
+ * @brief searches the root moves of this rank to the current depth, in the
+ * dispatch mode in use. Rank 0's move is only meaningful in dynamic dispatch,
+ * in static dispatch each rank returns the best of its own moves
+ * 
+ * @param my_colour players colour
+ * @param best_score set to the score of the best root move found, MIN if none
+ * @param fp file
+ * @return int best root move found, -1 if none
+ */
+int search_iteration(int my_colour, int *best_score, FILE *fp)
+{
+	int *moves = search_stack[0].moves;
+	int i, score, best_move = -1;
+
+	*best_score = MIN; //sortMoves(moves);
+	if (dispatch_mode == DISPATCH_DYNAMIC)
+	{
+		if (rank == 0)
+			best_move = dispatch_master(my_colour, best_score, fp);
+		else
+			dispatch_worker(my_colour, fp);
+		return best_move;
+	}
+	for (i = 1; i <= moves[0] && !search_stopped; i++)
+	{
+		//Debug("move %d for rank %d loc %d", moves[0], rank, moves[i]);
+		score = search_root_move(moves[i], my_colour, fp);
+		if (!search_stopped && score > *best_score)
+		{
+			*best_score = score;
+			best_move = moves[i];
+		}
+		// fprintf(fp, "score=%d at %d\n", score, moves[i]);
+	}
+	return best_move;
+}
+/**
+ * @brief plays a root move and searches the reply tree to the current depth,
+ * or to the end of the game in a solve iteration.
+ * The search only has to beat the best root score shared so far and the bottom
+ * of the aspiration window, a move that cannot is reported as MIN + 1 since
+ * its score is then only an upper bound
+ * 
+ * @param loc root move
+ * @param my_colour players colour
+ * @param fp file
+ * @return int minimax score of the move
+ */
+int search_root_move(int loc, int my_colour, FILE *fp)
+{
+	double begin = MPI_Wtime();
+	uint64_t flips = make_move(loc, my_colour, fp);
+	int score, high;
+
+	if (solve_window != 0)
+	{
+		// the opponent is to move in the solved position
+		score = -eg_solve(DISCS(opponent(my_colour, fp)), DISCS(my_colour), -solve_window, -max(-solve_window, root_bound));
+	}
+	else
+	{
+		// the window must stay above root_bound, which raises alpha at every node
+		high = (root_bound >= aspiration_high - 1) ? MAX : aspiration_high;
+		score = smp_search(1, 1, opponent(my_colour, fp), fp, aspiration_low, high);
+		if (high < MAX && (score >= high || root_bound >= high - 1) && !search_stopped)
+		{
+			// failed high, or another score passed the window meanwhile
+			score = smp_search(1, 1, opponent(my_colour, fp), fp, aspiration_low, MAX);
+		}
+	}
+	unmake_move(loc, flips, my_colour, fp);
+	busy_seconds += MPI_Wtime() - begin;
+	if (score <= max(root_bound, aspiration_low) && max(root_bound, aspiration_low) > MIN)
+	{
+		return MIN + 1; //no better than a move already searched, or below the window
+	}
+	if (!search_stopped)
+	{
+		publish_root_score(score);
+	}
+	return score;
+}
+/**
+ * @brief next root move to search this iteration, or -1 once the queue is empty
+ * or rank 0 has run out of time
+ * 
+ * @return int move
+ */
+int next_root_job()
+{
+	if (search_stopped || root_queue.next >= root_queue.moves[0])
+	{
+		return -1;
+	}
+	root_queue.next++;
+	return root_queue.moves[root_queue.next];
+}
+/**
+ * @brief whether the best root move of an iteration cut short can be played.
+ * Only moves searched to the end have scores, and only exact scores above the
+ * aspiration window compare. The best of them is safe once the move of the
+ * previous iteration is among the finished ones, since it is then no worse at
+ * this depth
+ *
+ * @param last_move best move of the last completed iteration
+ * @param best_score best finished score of the cut iteration, from dispatch_master
+ * @return int 1 if dispatch_master's move should be played
+ */
+int partial_iteration(int last_move, int best_score)
+{
+	int i;
+
+	if (last_move == -1 || best_score <= max(aspiration_low, MIN + 1))
+	{
+		return 0;
+	}
+	for (i = 1; i <= root_queue.moves[0]; i++)
+	{
+		if (root_queue.moves[i] == last_move)
+			return root_queue.score[i] != MIN;
+	}
+	return 0;
+}
+/**
+ * @brief stores a finished root move from rank 0 or a worker
+ * 
+ * @param result move, score, nodes searched, and whether the search completed
+ */
+void record_root_result(long *result)
+{
+	for (int i = 1; i <= root_queue.moves[0]; i++)
+	{
+		if (root_queue.moves[i] == result[0])
+		{
+			root_queue.cost[i] = result[2];
+			if (result[3])
+				root_queue.score[i] = result[1];
+			return;
+		}
+	}
+}
+/**
+ * @brief adds a rank to the idle list; when the list stops being empty the busy
+ * workers are told, so they know it is worth asking for helpers
+ * 
+ * @param r idle rank, 0 included once its own root moves are done
+ */
+void park_rank(int r)
+{
+	int ctrl[CTRLMSGSIZE] = {CTRL_IDLE, 0};
+	int i, w, parked;
+
+	parked_ranks[parked_count++] = r;
+	if (parked_count > 1)
+		return;
+	for (w = 1; w < size; w++)
+	{
+		parked = 0;
+		for (i = 0; i < parked_count; i++)
+			parked |= (parked_ranks[i] == w);
+		if (!parked)
+			MPI_Send(ctrl, CTRLMSGSIZE, MPI_INT, w, CTRL_TAG, MPI_COMM_WORLD);
+	}
+}
+/**
+ * @brief takes idle ranks off the idle list to help at a split point
+ * 
+ * @param wanted most helpers the split point can use
+ * @param helpers filled with the helper ranks
+ * @return int number of helpers taken
+ */
+int take_helpers(int wanted, int *helpers)
+{
+	int n = 0;
+	while (n < wanted && parked_count > 0)
+	{
+		helpers[n++] = parked_ranks[--parked_count];
+	}
+	return n;
+}
+/**
+ * @brief answers pending messages from workers: a work request carries the result
+ * of the worker's previous root move and gets the next move, or parks the worker
+ * once the queue is empty; a help request gets a list of idle ranks
+ */
+void serve_work_requests()
+{
+	int pending, job, wanted;
+	int ctrl[CTRLMSGSIZE];
+	long result[4];
+	MPI_Status status;
+
+	MPI_Iprobe(MPI_ANY_SOURCE, WORKREQUEST_TAG, MPI_COMM_WORLD, &pending, &status);
+	while (pending)
+	{
+		MPI_Recv(result, 4, MPI_LONG, status.MPI_SOURCE, WORKREQUEST_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		if (result[0] != -1)
+			record_root_result(result);
+		job = next_root_job();
+		if (job == -1)
+		{
+			park_rank(status.MPI_SOURCE);
+		}
+		else
+		{
+			ctrl[0] = CTRL_JOB;
+			ctrl[1] = job;
+			MPI_Send(ctrl, CTRLMSGSIZE, MPI_INT, status.MPI_SOURCE, CTRL_TAG, MPI_COMM_WORLD);
+		}
+		MPI_Iprobe(MPI_ANY_SOURCE, WORKREQUEST_TAG, MPI_COMM_WORLD, &pending, &status);
+	}
+
+	MPI_Iprobe(MPI_ANY_SOURCE, HELPREQUEST_TAG, MPI_COMM_WORLD, &pending, &status);
+	while (pending)
+	{
+		MPI_Recv(&wanted, 1, MPI_INT, status.MPI_SOURCE, HELPREQUEST_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		ctrl[0] = CTRL_HELPERS;
+		ctrl[1] = take_helpers(wanted, &ctrl[2]);
+		MPI_Send(ctrl, CTRLMSGSIZE, MPI_INT, status.MPI_SOURCE, CTRL_TAG, MPI_COMM_WORLD);
+		MPI_Iprobe(MPI_ANY_SOURCE, HELPREQUEST_TAG, MPI_COMM_WORLD, &pending, &status);
+	}
+}
+/**
+ * @brief handles messages that can arrive in the middle of a search: requests to
+ * rank 0, idle notices from rank 0, and an abort from the owner this rank helps
+ */
+void poll_messages()
+{
+	int pending;
+	int ctrl[CTRLMSGSIZE];
+	int64_t msg[SPLITMSGSIZE];
+
+	if (serving_requests)
+	{
+		serve_work_requests();
+	}
+	if (split_owner != -1 && !split_aborted)
+	{
+		// while a job is out the owner only ever sends an abort
+		MPI_Iprobe(split_owner, SPLIT_TAG, MPI_COMM_WORLD, &pending, MPI_STATUS_IGNORE);
+		if (pending)
+		{
+			MPI_Recv(msg, SPLITMSGSIZE, MPI_INT64_T, split_owner, SPLIT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			split_aborted = 1;
+		}
+	}
+	if (rank != 0)
+	{
+		// a busy worker only gets idle notices from rank 0
+		MPI_Iprobe(0, CTRL_TAG, MPI_COMM_WORLD, &pending, MPI_STATUS_IGNORE);
+		while (pending)
+		{
+			MPI_Recv(ctrl, CTRLMSGSIZE, MPI_INT, 0, CTRL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			helpers_hint = 1;
+			MPI_Iprobe(0, CTRL_TAG, MPI_COMM_WORLD, &pending, MPI_STATUS_IGNORE);
+		}
+	}
+}
+/**
+ * @brief asks rank 0 for idle ranks, skipped while there is no sign of any
+ * 
+ * @param wanted most helpers the split point can use
+ * @param helpers filled with the helper ranks
+ * @return int number of helpers granted
+ */
+int request_helpers(int wanted, int *helpers)
+{
+	int ctrl[CTRLMSGSIZE];
+
+	if (rank == 0)
+	{
+		return take_helpers(wanted, helpers);
+	}
+	if (!helpers_hint)
+	{
+		return 0;
+	}
+	MPI_Send(&wanted, 1, MPI_INT, 0, HELPREQUEST_TAG, MPI_COMM_WORLD);
+	do
+	{
+		MPI_Recv(ctrl, CTRLMSGSIZE, MPI_INT, 0, CTRL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+	} while (ctrl[0] != CTRL_HELPERS); //idle notices can come first
+	memcpy(helpers, &ctrl[2], ctrl[1] * sizeof(int));
+	if (ctrl[1] == 0)
+	{
+		helpers_hint = 0;
+	}
+	return ctrl[1];
+}
+/**
+ * @brief hands one sibling to a helper with the current window
+ */
+void send_split_job(int helper, int depth, int bMaxMin, int my_colour, int move, int alpha, int beta)
+{
+	int64_t msg[SPLITMSGSIZE] = {SPLIT_JOB, (int64_t)board.disc[0], (int64_t)board.disc[1], my_colour, move,
+								 depth, bMaxMin, alpha, beta, search_depth};
+	MPI_Send(msg, SPLITMSGSIZE, MPI_INT64_T, helper, SPLIT_TAG, MPI_COMM_WORLD);
+}
+/**
+ * @brief folds one sibling's score into the node, as the loops in minimax_score do
+ */
+void split_update(int bMaxMin, int move, int score, int *alpha, int *beta, int *best, int *best_move)
+{
+	if (bMaxMin == 0)
+	{
+		if (score > *best)
+		{
+			*best = score;
+			*best_move = move;
+		}
+		*alpha = max(*alpha, *best);
+	}
+	else
+	{
+		if (score < *best)
+		{
+			*best = score;
+			*best_move = move;
+		}
+		*beta = min(*beta, *best);
+	}
+}
+/**
+ * @brief Young Brothers Wait split point: called once the eldest child of a node
+ * has been searched, it shares the remaining siblings between this rank and any
+ * idle ranks, each helper getting the window current when its sibling is handed
+ * out. On a cutoff the helpers still busy are aborted and all are released.
+ * 
+ * @param depth depth of the node
+ * @param bMaxMin max(you) or min(opp) node
+ * @param my_colour side to move at the node
+ * @param moves the node's ordered moves, moves[1] already searched
+ * @param alpha node alpha, updated
+ * @param beta node beta, updated
+ * @param best best score so far, updated
+ * @param best_move best move so far, updated
+ * @param fp file
+ * @return int 1 if all siblings were searched here, 0 if no helper was free
+ */
+int split_point(int depth, int bMaxMin, int my_colour, int *moves, int *alpha, int *beta, int *best, int *best_move, FILE *fp)
+{
+	int helpers[MAXSPLITHELPERS], job_move[MAXSPLITHELPERS];
+	int nhelpers, next = 2, outstanding = 0, h, pending, score;
+	int64_t result[4];
+	uint64_t flips;
+
+	nhelpers = request_helpers(min(moves[0] - 2, MAXSPLITHELPERS), helpers);
+	if (nhelpers == 0)
+	{
+		return 0;
+	}
+	for (h = 0; h < nhelpers; h++)
+	{
+		job_move[h] = moves[next++];
+		send_split_job(helpers[h], depth, bMaxMin, my_colour, job_move[h], *alpha, *beta);
+		outstanding++;
+	}
+
+	while (*beta > *alpha && !search_stopped && !split_aborted)
+	{
+		for (h = 0; h < nhelpers; h++)
+		{
+			if (job_move[h] == -1)
+				continue;
+			MPI_Iprobe(helpers[h], SPLITRESULT_TAG, MPI_COMM_WORLD, &pending, MPI_STATUS_IGNORE);
+			if (!pending)
+				continue;
+			MPI_Recv(result, 4, MPI_INT64_T, helpers[h], SPLITRESULT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+			job_move[h] = -1;
+			outstanding--;
+			if (!result[3])
+			{
+				search_stopped = 1; //helper ran out of time
+				break;
+			}
+			split_update(bMaxMin, result[0], result[1], alpha, beta, best, best_move);
+			if (*beta > *alpha && next <= moves[0])
+			{
+				job_move[h] = moves[next++];
+				send_split_job(helpers[h], depth, bMaxMin, my_colour, job_move[h], *alpha, *beta);
+				outstanding++;
+			}
+		}
+		if (*beta <= *alpha || search_stopped)
+		{
+			break;
+		}
+		if (next <= moves[0])
+		{
+			// search a sibling here as well
+			flips = make_move(moves[next], my_colour, fp);
+			score = minimax_score(depth + 1, !bMaxMin, opponent(my_colour, fp), fp, *alpha, *beta);
+			unmake_move(moves[next], flips, my_colour, fp);
+			if (!search_stopped && !split_aborted)
+				split_update(bMaxMin, moves[next], score, alpha, beta, best, best_move);
+			next++;
+		}
+		else if (outstanding == 0)
+		{
+			break;
+		}
+		else
+		{
+			poll_messages();
+		}
+	}
+
+	// abort whatever is still running, collect and drop those results, then release everyone
+	for (h = 0; h < nhelpers; h++)
+	{
+		if (job_move[h] != -1)
+		{
+			int64_t msg[SPLITMSGSIZE] = {SPLIT_ABORT};
+			MPI_Send(msg, SPLITMSGSIZE, MPI_INT64_T, helpers[h], SPLIT_TAG, MPI_COMM_WORLD);
+		}
+	}
+	while (outstanding > 0)
+	{
+		for (h = 0; h < nhelpers; h++)
+		{
+			if (job_move[h] == -1)
+				continue;
+			MPI_Iprobe(helpers[h], SPLITRESULT_TAG, MPI_COMM_WORLD, &pending, MPI_STATUS_IGNORE);
+			if (pending)
+			{
+				MPI_Recv(result, 4, MPI_INT64_T, helpers[h], SPLITRESULT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+				job_move[h] = -1;
+				outstanding--;
+			}
+		}
+		poll_messages();
+	}
+	for (h = 0; h < nhelpers; h++)
+	{
+		int64_t msg[SPLITMSGSIZE] = {SPLIT_RELEASE};
+		MPI_Send(msg, SPLITMSGSIZE, MPI_INT64_T, helpers[h], SPLIT_TAG, MPI_COMM_WORLD);
+	}
+	return 1;
+}
+/**
+ * @brief searches siblings handed out by the owner of a split point until the
+ * owner releases this rank; the rank's own board is restored afterwards
+ * 
+ * @param owner rank that owns the split point
+ * @param fp file
+ */
+void help_owner(int owner, FILE *fp)
+{
+	int64_t msg[SPLITMSGSIZE], result[4];
+	int pending, colour, move;
+	long nodes;
+	double begin;
+	uint64_t flips;
+	bitboard_t saved_board = board;
+	uint64_t saved_hash = board_hash;
+	features_t saved_features = features;
+
+	split_owner = owner;
+	while (1)
+	{
+		if (rank == 0)
+		{
+			// rank 0 keeps serving requests, and the time and the referee, while it waits
+			do
+			{
+				serve_work_requests();
+				stop_check();
+				MPI_Iprobe(owner, SPLIT_TAG, MPI_COMM_WORLD, &pending, MPI_STATUS_IGNORE);
+			} while (!pending);
+		}
+		MPI_Recv(msg, SPLITMSGSIZE, MPI_INT64_T, owner, SPLIT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		if (msg[0] == SPLIT_RELEASE)
+		{
+			break;
+		}
+		if (msg[0] == SPLIT_ABORT)
+		{
+			continue; //arrived after the result was sent
+		}
+		board.disc[0] = msg[1];
+		board.disc[1] = msg[2];
+		board_hash = tt_hash(&board);
+		features_init();
+		colour = msg[3];
+		move = msg[4];
+		search_depth = msg[9];
+		split_aborted = 0;
+		nodes = search_nodes;
+		begin = MPI_Wtime();
+		flips = make_move(move, colour, fp);
+		result[0] = move;
+		result[1] = smp_search(msg[5] + 1, !msg[6], opponent(colour, fp), fp, msg[7], msg[8]);
+		result[2] = search_nodes - nodes;
+		result[3] = !search_stopped && !split_aborted;
+		unmake_move(move, flips, colour, fp);
+		busy_seconds += MPI_Wtime() - begin;
+		MPI_Send(result, 4, MPI_INT64_T, owner, SPLITRESULT_TAG, MPI_COMM_WORLD);
+	}
+	split_aborted = 0;
+	split_owner = -1;
+	board = saved_board;
+	board_hash = saved_hash;
+	features = saved_features;
+}
+/**
+ * @brief starts the helper threads of this rank
+ */
+void smp_init()
+{
+	smp_threads = (smp_threads < 1) ? 1 : (smp_threads > MAXTHREADS) ? MAXTHREADS : smp_threads;
+	for (int t = 1; t < smp_threads; t++)
+	{
+		if (pthread_create(&smp_pool[t], NULL, smp_helper, (void *)(intptr_t)t) != 0)
+		{
+			smp_threads = t; //run with the threads we got
+			break;
+		}
+	}
+}
+
+void smp_free()
+{
+	pthread_mutex_lock(&smp_lock);
+	smp_quit = 1;
+	pthread_cond_broadcast(&smp_start);
+	pthread_mutex_unlock(&smp_lock);
+	for (int t = 1; t < smp_threads; t++)
+		pthread_join(smp_pool[t], NULL);
+}
+
+/**
+ * @brief helper thread loop, searches every job it is handed until the main
+ * thread raises smp_abort. Its scores only reach the main thread through the
+ * transposition table
+ * 
+ * @param arg thread id
+ */
+void *smp_helper(void *arg)
+{
+	int seen = 0;
+	long nodes, leaves;
+
+	thread_id = (int)(intptr_t)arg;
+	pthread_mutex_lock(&smp_lock);
+	while (1)
+	{
+		while (smp_generation == seen && !smp_quit)
+			pthread_cond_wait(&smp_start, &smp_lock);
+		if (smp_quit)
+			break;
+		seen = smp_generation;
+		board = smp_job.board;
+		board_hash = tt_hash(&board);
+		features_init();
+		search_depth = smp_job.search_depth;
+		search_stopped = 0;
+		pthread_mutex_unlock(&smp_lock);
+
+		nodes = search_nodes;
+		leaves = search_leaves;
+		minimax_score(smp_job.depth, smp_job.bMaxMin, smp_job.colour, NULL, smp_job.alpha, smp_job.beta);
+
+		pthread_mutex_lock(&smp_lock);
+		smp_nodes += search_nodes - nodes;
+		smp_leaves += search_leaves - leaves;
+		if (--smp_busy == 0)
+			pthread_cond_signal(&smp_done);
+	}
+	pthread_mutex_unlock(&smp_lock);
+	return NULL;
+}
+
+/**
+ * @brief minimax_score on the current board with the helper threads searching
+ * the same subtree alongside, for subtrees big enough to pay for waking them
+ * 
+ * @return int score found by the main thread
+ */
+int smp_search(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta)
+{
+	int score;
+
+	if (smp_threads == 1 || search_depth - depth < SMP_MIN_DEPTH)
+	{
+		return minimax_score(depth, bMaxMin, my_colour, fp, alpha, beta);
+	}
+	pthread_mutex_lock(&smp_lock);
+	smp_job.board = board;
+	smp_job.depth = depth;
+	smp_job.bMaxMin = bMaxMin;
+	smp_job.colour = my_colour;
+	smp_job.alpha = alpha;
+	smp_job.beta = beta;
+	smp_job.search_depth = search_depth;
+	smp_abort = 0;
+	smp_busy = smp_threads - 1;
+	smp_generation++;
+	pthread_cond_broadcast(&smp_start);
+	pthread_mutex_unlock(&smp_lock);
+
+	score = minimax_score(depth, bMaxMin, my_colour, fp, alpha, beta);
+
+	smp_abort = 1;
+	pthread_mutex_lock(&smp_lock);
+	while (smp_busy > 0)
+		pthread_cond_wait(&smp_done, &smp_lock);
+	pthread_mutex_unlock(&smp_lock);
+	return score;
+}
+/**
+ * @brief rank 0 side of one dynamic dispatch iteration: orders the root moves by
+ * their cost in the previous iteration so the largest subtrees start first, then
+ * searches moves itself while handing the rest out to workers as they ask. Once
+ * the queue is empty rank 0 idles as a helper until every rank is idle
+ * 
+ * @param my_colour players colour
+ * @param best_score set to the score of the best root move
+ * @param fp file
+ * @return int best root move, -1 if there are none
+ */
+int dispatch_master(int my_colour, int *best_score, FILE *fp)
+{
+	int i, j, move, pending, best_move = -1;
+	int ctrl[CTRLMSGSIZE] = {CTRL_JOB, -1};
+	long result[4], nodes, tmp_cost;
+	MPI_Status status;
+
+	// insertion sort, most nodes first
+	for (i = 2; i <= root_queue.moves[0]; i++)
+	{
+		move = root_queue.moves[i];
+		tmp_cost = root_queue.cost[i];
+		for (j = i - 1; j >= 1 && root_queue.cost[j] < tmp_cost; j--)
+		{
+			root_queue.moves[j + 1] = root_queue.moves[j];
+			root_queue.cost[j + 1] = root_queue.cost[j];
+		}
+		root_queue.moves[j + 1] = move;
+		root_queue.cost[j + 1] = tmp_cost;
+	}
+	for (i = 1; i <= root_queue.moves[0]; i++)
+		root_queue.score[i] = MIN;
+	root_queue.next = 0;
+	parked_count = 0;
+
+	serving_requests = 1;
+	while ((move = next_root_job()) != -1)
+	{
+		nodes = search_nodes;
+		result[0] = move;
+		result[1] = search_root_move(move, my_colour, fp);
+		result[2] = search_nodes - nodes;
+		result[3] = !search_stopped;
+		record_root_result(result);
+		serve_work_requests();
+	}
+	park_rank(0);
+	while (parked_count < size)
+	{
+		serve_work_requests();
+		stop_check();
+		MPI_Iprobe(MPI_ANY_SOURCE, SPLIT_TAG, MPI_COMM_WORLD, &pending, &status);
+		if (pending)
+		{
+			help_owner(status.MPI_SOURCE, fp); //someone took rank 0 off the idle list
+			park_rank(0);
+		}
+	}
+	serving_requests = 0;
+	// every rank is idle, end the iteration
+	for (i = 0; i < parked_count; i++)
+	{
+		if (parked_ranks[i] != 0)
+			MPI_Send(ctrl, CTRLMSGSIZE, MPI_INT, parked_ranks[i], CTRL_TAG, MPI_COMM_WORLD);
+	}
+	parked_count = 0;
+
+	*best_score = MIN;
+	for (i = 1; i <= root_queue.moves[0]; i++)
+	{
+		if (root_queue.score[i] > *best_score)
+		{
+			*best_score = root_queue.score[i];
+			best_move = root_queue.moves[i];
+		}
+	}
+	return best_move;
 }
 /**
- * @brief decides best strategy move for player based on the best minimax score
+ * @brief worker side of one dynamic dispatch iteration: asks rank 0 for root
+ * moves, returning each result with the next request, and helps at other ranks'
+ * split points while it is idle, until rank 0 ends the iteration
  * 
  * @param my_colour players colour
  * @param fp file
- * @return int best move
  */
+void dispatch_worker(int my_colour, FILE *fp)
+{
+	int ctrl[CTRLMSGSIZE];
+	long result[4] = {-1, 0, 0, 0};
+	long nodes;
+	MPI_Status status;
 
-int minimax_strategy(int my_colour, FILE *fp)
+	MPI_Send(result, 4, MPI_LONG, 0, WORKREQUEST_TAG, MPI_COMM_WORLD);
+	while (1)
+	{
+		MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+		if (status.MPI_TAG == SPLIT_TAG)
+		{
+			help_owner(status.MPI_SOURCE, fp);
+			result[0] = -1;
+			MPI_Send(result, 4, MPI_LONG, 0, WORKREQUEST_TAG, MPI_COMM_WORLD);
+			continue;
+		}
+		MPI_Recv(ctrl, CTRLMSGSIZE, MPI_INT, 0, CTRL_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		if (ctrl[0] != CTRL_JOB)
+		{
+			continue; //idle notice, this rank is idle itself
+		}
+		if (ctrl[1] == -1)
+		{
+			break;
+		}
+		nodes = search_nodes;
+		result[0] = ctrl[1];
+		result[1] = search_root_move(ctrl[1], my_colour, fp);
+		result[2] = search_nodes - nodes;
+		result[3] = !search_stopped;
+		MPI_Send(result, 4, MPI_LONG, 0, WORKREQUEST_TAG, MPI_COMM_WORLD);
+	}
+}
+/**
+ * @brief splits the referee time limit into the search budget for one move
+ * 
+ * @param time_limit seconds per move given by the referee
+ */
+void set_move_budget(double time_limit)
 {
-	int i, loc, best_score, best_move = 0, score;
-	int *moves = (int *)malloc(LEGALMOVSBUFSIZE / size * sizeof(int));
-	memset(moves, 0, LEGALMOVSBUFSIZE);
-	int *original_board = (int *)malloc(BOARDSIZE * sizeof(int));
-	// duplicateBoard(board, original_board); //copied original state of board
-	memcpy(original_board, board, BOARDSIZE * sizeof(int));
-	//get moves from get proc legal moves instead of legal moves
-	rank_legal_moves(my_colour, moves, fp);
-	//legal_moves(my_colour, moves, fp);
-	// Debug("move %d for rank %d", moves[0], rank);
-	if (moves[0] <= 0)
+	if (time_limit <= 0)
 	{
-		return -1; //no moves
+		time_limit = 1.0; //no limit given, stay quick
 	}
-	else
+	move_budget = time_limit * TIME_FRACTION - TIME_RESERVE;
+	if (move_budget < 0.05)
 	{
-		best_score = MIN; //sortMoves(moves);
-		for (i = 1; i <= moves[0]; i++)
+		move_budget = 0.05;
+	}
+}
+/**
+ * @brief checks every TIMECHECKNODES nodes whether rank 0 has stopped the
+ * search, rank 0 itself checks the clock. The first iteration always runs to
+ * completion so there is a move to fall back on. Messages from other ranks are
+ * handled here too while searching in dynamic dispatch mode
+ * 
+ * @return int 1 once the current search has to stop or was aborted by its owner
+ */
+int search_timeout()
+{
+	search_nodes++;
+	if ((search_nodes % TIMECHECKNODES) == 0 && thread_id != 0)
+	{
+		search_stopped = smp_abort;
+	}
+	else if ((search_nodes % TIMECHECKNODES) == 0)
+	{
+		poll_messages();
+		refresh_root_bound();
+		stop_check();
+		if (!search_stopped && search_depth > 1 && rank != 0 && MPI_Wtime() > search_deadline + STOP_GRACE)
 		{
-			// duplicateBoard(original_board, board);
-			memcpy(board, original_board, BOARDSIZE * sizeof(int));
-			loc = moves[i];
-			//Debug("move %d for rank %d loc %d", moves[0], rank, loc);
-			make_move(loc, my_colour, fp);
-			score = minimax_score(1, 1, opponent(my_colour, fp), fp, MIN, MAX);
-			if (score > best_score)
-			{
-				best_score = score;
-				best_move = moves[i];
-			}
-			// fprintf(fp, "score=%d at %d\n", score, loc);
+			search_stopped = 1; //rank 0's stop is late, do not wait for it
 		}
-		// fprintf(fp, "bestie score=%d at %d\n", best_score, best_move);
-		//duplicateBoard(original_board, board); //reset board to original_board before move
-		memcpy(board, original_board, BOARDSIZE * sizeof(int));
-		free(moves);
-		free(original_board);
-		best_val = best_score;
-		return best_move;
 	}
+	return search_stopped || split_aborted;
 }
 /**
  * @brief recursively called by minimax strategy, determining future moves for both max and min players 
@@ -699,83 +2441,254 @@ int minimax_strategy(int my_colour, FILE *fp)
  */
 int minimax_score(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta)
 {
-	int i;
-	int *moves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	memset(moves, 0, LEGALMOVSBUFSIZE);
-	int *original_board = (int *)malloc(BOARDSIZE * sizeof(int));
-	//duplicateBoard(board, original_board); //copied original state of board
-	memcpy(original_board, board, BOARDSIZE * sizeof(int));
-	int best;
-
-	if (depth == MAXDEPTH)
-	{
-		//duplicateBoard(original_board, board); //reset board to original_board before move
-		memcpy(board, original_board, BOARDSIZE * sizeof(int));
-		free(moves);
-		free(original_board);
-		// if (bMaxMin == 0)
-		// {
-		return evaluatePosition(my_colour, fp); //colour for max?
-												// }
-												// return evaluatePosition(opponent(my_colour, fp), fp); //colour for max?
+	int i, score, best, best_move = TT_NOMOVE, bound;
+	int alpha_orig = alpha, beta_orig = beta;
+	int hash_move = TT_NOMOVE, found;
+	int *moves = search_stack[depth].moves;
+	uint64_t key, flips;
+	tt_entry_t entry, remote;
+
+	if (search_timeout())
+	{
+		return 0; //result is discarded
+	}
+
+	if (depth == search_depth)
+	{
+		search_leaves++;
+		// always score for the max player, whichever side is to move at this depth
+		if (bMaxMin == 0)
+		{
+			return evaluatePosition(my_colour, fp);
+		}
+		return evaluatePosition(opponent(my_colour, fp), fp);
 	}
+
+	// every root move has to beat the best one any rank has finished
+	alpha = max(alpha, shared_bound());
+
+	// a stored result that is deep enough and fits the window ends the search here
+	key = board_hash ^ (my_colour == WHITE ? zobrist_white : 0);
+	found = tt_probe(key, &entry);
+	if (dtt_enabled && thread_id == 0 && search_depth - depth >= DTT_MINDEPTH && (!found || entry.depth < search_depth - depth) &&
+		dtt_probe(key, &remote) && (!found || remote.depth > entry.depth))
+	{
+		// another rank searched it deeper, kept locally for the next visit
+		entry = remote;
+		found = 1;
+		tt_store(key, entry.depth, entry.bound, entry.score, entry.move);
+	}
+	if (found)
+	{
+		hash_move = entry.move;
+		if (entry.depth >= search_depth - depth &&
+			(entry.bound == TT_EXACT || (entry.bound == TT_LOWER && entry.score >= beta) || (entry.bound == TT_UPPER && entry.score <= alpha)))
+		{
+			return entry.score;
+		}
+	}
+
+	// a shallow search far enough outside the window stands in for this one
+	if (probcut_enabled && !in_probcut && search_depth - depth >= MPC_MINDEPTH && search_depth - depth <= MPC_MAXDEPTH &&
+		probcut(depth, bMaxMin, my_colour, fp, alpha, beta, &score))
+	{
+		return score;
+	}
+
 	legal_moves(my_colour, moves, fp); //all possible moves
 	if (moves[0] <= 0)
 	{
-		return -1; //no moves
+		if (bb_moves(DISCS(opponent(my_colour, fp)), DISCS(my_colour)) != 0)
+		{
+			return minimax_score(depth + 1, !bMaxMin, opponent(my_colour, fp), fp, alpha, beta); //pass
+		}
+		// game over, scored for the max player like the leaves
+		score = bb_count(DISCS(my_colour)) - bb_count(DISCS(opponent(my_colour, fp)));
+		return WIN_WEIGHT * ((bMaxMin == 0) ? score : -score);
+	}
+	order_moves(moves, depth, my_colour, hash_move);
+	if (thread_id != 0 && moves[0] > 2)
+	{
+		rotateMoves(moves, thread_id); //helpers take the siblings in another order
 	}
 	//
 	if (bMaxMin == 0)
 	{
 		best = MIN;
-		sortMoves(moves);
 		for (i = 1; i <= moves[0]; i++)
 		{
-			//duplicateBoard(original_board, board);
-			memcpy(board, original_board, BOARDSIZE * sizeof(int));
-			make_move(moves[i], my_colour, fp);
-			int score = minimax_score(depth + 1, 1, opponent(my_colour, fp), fp, alpha, beta);
-			best = max(best, score);
-			alpha = max(alpha, best);
-
-			alpha_sharing_top(alpha, 0);
+			flips = make_move(moves[i], my_colour, fp);
+			score = search_child(depth + 1, 1, opponent(my_colour, fp), fp, alpha, beta, i == 1);
+			unmake_move(moves[i], flips, my_colour, fp);
+			if (score > best)
+			{
+				best = score;
+				best_move = moves[i];
+			}
+			alpha = max(alpha, max(best, shared_bound()));
+			if (search_stopped || split_aborted)
+			{
+				break;
+			}
 			if (beta <= alpha)
 			{
+				order_cutoff(moves, i, depth, my_colour, search_depth - depth);
 				break; //prune
 			}
+			if (i == 1 && moves[0] > 2 && search_depth - depth >= SPLIT_MIN_DEPTH && dispatch_mode == DISPATCH_DYNAMIC && thread_id == 0 && !in_probcut &&
+				split_point(depth, bMaxMin, my_colour, moves, &alpha, &beta, &best, &best_move, fp))
+			{
+				break; //young brothers searched in parallel
+			}
 		}
-		//duplicateBoard(original_board, board); //reset board to original_board before move
-		memcpy(board, original_board, BOARDSIZE * sizeof(int));
-		free(moves);
-		free(original_board);
-		//return best;
 	}
 	else
 	{
 		best = MAX;
-		sortMoves(moves);
 		for (i = 1; i <= moves[0]; i++)
 		{
-			//duplicateBoard(original_board, board);
-			memcpy(board, original_board, BOARDSIZE * sizeof(int));
-			make_move(moves[i], my_colour, fp);
-			int score = minimax_score(depth + 1, 0, opponent(my_colour, fp), fp, alpha, beta);
-			best = min(best, score);
+			flips = make_move(moves[i], my_colour, fp);
+			score = search_child(depth + 1, 0, opponent(my_colour, fp), fp, alpha, beta, i == 1);
+			unmake_move(moves[i], flips, my_colour, fp);
+			if (score < best)
+			{
+				best = score;
+				best_move = moves[i];
+			}
 			beta = min(beta, best);
-
+			alpha = max(alpha, shared_bound());
+			if (search_stopped || split_aborted)
+			{
+				break;
+			}
 			if (beta <= alpha)
 			{
+				order_cutoff(moves, i, depth, my_colour, search_depth - depth);
 				break; //prune
 			}
+			if (i == 1 && moves[0] > 2 && search_depth - depth >= SPLIT_MIN_DEPTH && dispatch_mode == DISPATCH_DYNAMIC && thread_id == 0 && !in_probcut &&
+				split_point(depth, bMaxMin, my_colour, moves, &alpha, &beta, &best, &best_move, fp))
+			{
+				break; //young brothers searched in parallel
+			}
+		}
+	}
+
+	if (!search_stopped && !split_aborted)
+	{
+		// root_bound only grows during an iteration, so it covers every alpha raised below
+		bound = (best <= max(alpha_orig, shared_bound())) ? TT_UPPER : (best >= beta_orig) ? TT_LOWER : TT_EXACT;
+		tt_store(key, search_depth - depth, bound, best, best_move);
+		if (dtt_enabled && thread_id == 0 && search_depth - depth >= DTT_MINDEPTH)
+		{
+			dtt_store(key, search_depth - depth, bound, best, best_move);
 		}
-		//duplicateBoard(original_board, board); //reset board to original_board before move
-		memcpy(board, original_board, BOARDSIZE * sizeof(int));
-		free(moves);
-		free(original_board);
-		//return best;
 	}
 	return best;
 }
+/**
+ * @brief searches a child of the current node. With PVS a sibling after the
+ * first only has to be shown no better than the best so far, which a null
+ * window does cheaply, and is searched again with the full window if it is better
+ * 
+ * @param depth depth of the child
+ * @param bMaxMin 0 if the child is a max node, 1 if a min node
+ * @param my_colour colour to move at the child
+ * @param fp file
+ * @param alpha lower bound of the parent's window
+ * @param beta upper bound of the parent's window
+ * @param first whether this is the first child searched
+ * @return int score of the child, a bound if outside the window
+ */
+int search_child(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta, int first)
+{
+	int score;
+
+	if (first || search_mode != SEARCH_PVS || beta - alpha <= 1)
+	{
+		return minimax_score(depth, bMaxMin, my_colour, fp, alpha, beta);
+	}
+	if (bMaxMin == 1)
+	{
+		score = minimax_score(depth, 1, my_colour, fp, alpha, alpha + 1); //the parent maximises
+	}
+	else
+	{
+		score = minimax_score(depth, 0, my_colour, fp, beta - 1, beta);
+	}
+	if (score <= alpha || score >= beta || search_stopped || split_aborted)
+	{
+		return score;
+	}
+	return minimax_score(depth, bMaxMin, my_colour, fp, alpha, beta);
+}
+/**
+ * @brief root_bound as seen by the search. ProbCut's shallow searches test
+ * their own null windows, which the shared bound must not move
+ */
+int shared_bound()
+{
+	return in_probcut ? MIN : root_bound;
+}
+
+/**
+ * @brief Multi-ProbCut: shallow searches of the node, cheapest first, predict
+ * the deep score through the fitted lines. Once the prediction is more than
+ * MPC_DEFAULT_T deviations beyond beta or below alpha the node is cut
+ * 
+ * @param depth depth of the node
+ * @param bMaxMin 0 for a max node, 1 for a min node
+ * @param my_colour colour to move
+ * @param fp file
+ * @param alpha lower bound of the window
+ * @param beta upper bound of the window
+ * @param score set to the bound the node is cut at
+ * @return int 1 if the node is cut
+ */
+int probcut(int depth, int bMaxMin, int my_colour, FILE *fp, int alpha, int beta, int *score)
+{
+	int deep = search_depth - depth, shallow[MPC_MAXSHALLOW], n, k, bound, cut = 0;
+	int sign = (bMaxMin == 0) ? 1 : -1; //fits are for the player to move, scores here for the max player
+	double margin, limit;
+	const mpc_fit_t *fit;
+
+	n = mpc_shallow(deep, shallow);
+	in_probcut = 1;
+	for (k = 0; k < n && !cut && !search_stopped; k++)
+	{
+		fit = &mpc_fits[mpc_phase(features.discs[0] + features.discs[1])][deep][shallow[k]];
+		if (fit->sigma <= 0)
+		{
+			continue;
+		}
+		margin = MPC_DEFAULT_T * fit->sigma;
+		search_depth = depth + shallow[k];
+		// deep >= beta is likely once a * shallow + b - margin >= beta
+		limit = (beta - sign * fit->b + margin) / fit->a;
+		if (beta < MAX && limit < MAX)
+		{
+			bound = (int)ceil(limit);
+			if (minimax_score(depth, bMaxMin, my_colour, fp, bound - 1, bound) >= bound)
+			{
+				*score = beta;
+				cut = 1;
+			}
+		}
+		limit = (alpha - sign * fit->b - margin) / fit->a;
+		if (!cut && alpha > MIN && limit > MIN)
+		{
+			bound = (int)floor(limit);
+			if (minimax_score(depth, bMaxMin, my_colour, fp, bound, bound + 1) <= bound)
+			{
+				*score = alpha;
+				cut = 1;
+			}
+		}
+		search_depth = depth + deep;
+	}
+	in_probcut = 0;
+	return cut && !search_stopped && !split_aborted;
+}
 
 /**
  * Find maximum between two numbers.
@@ -802,6 +2715,11 @@ int min(int num1, int num2)
  */
 int evaluatePosition(int my_colour, FILE *fp)
 {
+	if (eval_mode == EVAL_PATTERN)
+	{
+		int score = pattern_score(&features.patterns, board.disc[0], board.disc[1]);
+		return (my_colour == BLACK) ? score : -score;
+	}
 	//int mobilityScore = evaluateMobility(my_colour, fp);
 	//int discDifference = evaluateDiscDifference(my_colour, fp);
 	//int stabilityScore = evaluateStability(my_colour, fp);
@@ -962,17 +2880,33 @@ int evaluatePosition(int my_colour, FILE *fp)
  */
 int evaluateMobility(int my_colour, FILE *fp)
 {
-	int *playerMoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	int *opponentMoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
+	uint64_t own = DISCS(my_colour), opp = DISCS(opponent(my_colour, fp));
+	int playerMoves = bb_count(bb_moves(own, opp));
+	int opponentMoves = bb_count(bb_moves(opp, own));
 
-	legal_moves(my_colour, playerMoves, fp);
-	legal_moves(opponent(my_colour, fp), opponentMoves, fp);
-
-	if ((playerMoves[0] + opponentMoves[0]) <= 0)
+	if ((playerMoves + opponentMoves) <= 0)
 	{
 		return 0;
 	}
-	return 100 * (playerMoves[0] - opponentMoves[0]) / (playerMoves[0] + opponentMoves[0]);
+	return 100 * (playerMoves - opponentMoves) / (playerMoves + opponentMoves);
+}
+/**
+ * @brief sum of the weights of every square covered by discs
+ * 
+ * @param discs occupancy mask
+ * @param weights per square weights
+ * @return int summed weight
+ */
+int weightSum(uint64_t discs, int weights[8][8])
+{
+	int sum = 0;
+	while (discs)
+	{
+		int sq = bb_first(discs);
+		sum += weights[SQ_ROW(sq)][SQ_COL(sq)];
+		discs &= discs - 1;
+	}
+	return sum;
 }
 /**
  * @brief more of a static board than stability, but favours stable and semi stable positions
@@ -983,21 +2917,8 @@ int evaluateMobility(int my_colour, FILE *fp)
  */
 int evaluateStability(int my_colour, FILE *fp)
 {
-	int playerScore = 0, opponentScore = 0;
-	for (int i = 11; i <= 88; i++)
-	{
-		int x = i / 10;
-		int y = i % 10;
-		int val = stabilityWeights2[x - 1][y - 1];
-		if (board[i] == my_colour)
-		{ //black
-			playerScore += val;
-		}
-		else if (board[i] == opponent(my_colour, fp))
-		{ //white
-			opponentScore += val;
-		}
-	}
+	int playerScore = features.stability[my_colour - 1];
+	int opponentScore = features.stability[opponent(my_colour, fp) - 1];
 	if ((playerScore + opponentScore) == 0)
 	{
 		return 0;
@@ -1013,21 +2934,8 @@ int evaluateStability(int my_colour, FILE *fp)
  */
 int evaluateCorners(int my_colour, FILE *fp)
 {
-	int playerScore = 0, opponentScore = 0;
-	for (int i = 11; i <= 88; i++)
-	{
-		int x = i / 10;
-		int y = i % 10;
-		int val = cornersWeights[x - 1][y - 1];
-		if (board[i] == my_colour)
-		{ //black
-			playerScore += val;
-		}
-		else if (board[i] == opponent(my_colour, fp))
-		{ //white
-			opponentScore += val;
-		}
-	}
+	int playerScore = features.corners[my_colour - 1];
+	int opponentScore = features.corners[opponent(my_colour, fp) - 1];
 	if ((playerScore + opponentScore) == 0)
 	{
 		return 0;
@@ -1049,44 +2957,16 @@ int evaluateCorners(int my_colour, FILE *fp)
 int all_in_one(int my_colour, int d, int c, int s, int m, int e, int w)
 {
 	int opp_colour = opponent(my_colour, NULL);
-	int my_discs = 0, opp_discs = 0, j, k, my_edge_discs = 0, opp_edge_discs = 0, x, y;
+	int me = my_colour - 1, them = opp_colour - 1;
+	uint64_t own = DISCS(my_colour), opp = DISCS(opp_colour);
+	uint64_t empty = ~(own | opp);
+	int my_discs, opp_discs;
 	double discScore = 0, cornersScore = 0, stabilityCorners = 0, mobilityScore = 0, edges = 0, staticWeight = 0;
 
-	int X1[] = {-1, -1, 0, 1, 1, 1, 0, -1};
-	int Y1[] = {0, 1, 1, 1, 0, -1, -1, -1};
-
-	// Piece difference, frontier disks and disk squares
-	for (int i = 11; i <= 88; i++)
-	{
-		x = (i / 10) - 1;
-		y = (i % 10) - 1;
-		if (board[i] == my_colour)
-		{
-			staticWeight += stabilityWeights2[x][y];
-			my_discs++;
-		}
-		else if (board[i] == opp_colour)
-		{
-			staticWeight -= stabilityWeights2[x][y]; //weightings
-			opp_discs++;
-		}
-		if (board[i] != EMPTY)
-		{
-			for (k = 0; k < 8; k++)
-			{
-				x = i + X1[k];
-				y = j + Y1[k];
-				if (x >= 0 && x < 8 && y >= 0 && y < 8 && board[i] == EMPTY)
-				{
-					if (board[i] == my_colour)
-						my_edge_discs++; //edges
-					else
-						opp_edge_discs++;
-					break;
-				}
-			}
-		}
-	}
+	// Piece difference and disk squares
+	my_discs = features.discs[me];
+	opp_discs = features.discs[them];
+	staticWeight = features.stability[me] - features.stability[them]; //weightings
 
 	if (my_discs > opp_discs)
 		discScore = (100.0 * my_discs) / (my_discs + opp_discs);
@@ -1095,107 +2975,27 @@ int all_in_one(int my_colour, int d, int c, int s, int m, int e, int w)
 	else
 		discScore = 0; //discs
 
-	if (my_edge_discs > opp_edge_discs)
-		edges = -(100.0 * my_edge_discs) / (my_edge_discs + opp_edge_discs);
-	else if (my_edge_discs < opp_edge_discs)
-		edges = (100.0 * opp_edge_discs) / (my_edge_discs + opp_edge_discs);
-	else
-		edges = 0; //edges
+	// Frontier discs were never counted by the old square scan, so edges stays
+	// at zero to keep the tuned weights meaningful
 
 	// Corner occupancy
-	my_discs = opp_discs = 0;
-	if (board[11] == my_colour)
-		my_discs++;
-	else if (board[11] == opp_colour)
-		opp_discs++;
-	if (board[18] == my_colour)
-		my_discs++;
-	else if (board[18] == opp_colour)
-		opp_discs++;
-	if (board[81] == my_colour)
-		my_discs++;
-	else if (board[81] == opp_colour)
-		opp_discs++;
-	if (board[88] == my_colour)
-		my_discs++;
-	else if (board[88] == opp_colour)
-		opp_discs++;
-	cornersScore = 25 * (my_discs - opp_discs);
-
-	// Corner closeness
-	my_discs = opp_discs = 0;
-	if (board[11] == EMPTY)
-	{
-		if (board[12] == my_colour)
-			my_discs++;
-		else if (board[12] == opp_colour)
-			opp_discs++;
-		if (board[22] == my_colour)
-			my_discs++;
-		else if (board[22] == opp_colour)
-			opp_discs++;
-		if (board[21] == my_colour)
-			my_discs++;
-		else if (board[21] == opp_colour)
-			opp_discs++;
-	}
-	if (board[18] == EMPTY)
-	{
-		if (board[17] == my_colour)
-			my_discs++;
-		else if (board[17] == opp_colour)
-			opp_discs++;
-		if (board[27] == my_colour)
-			my_discs++;
-		else if (board[27] == opp_colour)
-			opp_discs++;
-		if (board[28] == my_colour)
-			my_discs++;
-		else if (board[28] == opp_colour)
-			opp_discs++;
-	}
-	if (board[81] == EMPTY)
-	{
-		if (board[82] == my_colour)
-			my_discs++;
-		else if (board[82] == opp_colour)
-			opp_discs++;
-		if (board[72] == my_colour)
-			my_discs++;
-		else if (board[72] == opp_colour)
-			opp_discs++;
-		if (board[71] == my_colour)
-			my_discs++;
-		else if (board[71] == opp_colour)
-			opp_discs++;
-	}
-	if (board[88] == EMPTY)
-	{
-		if (board[78] == my_colour)
-			my_discs++;
-		else if (board[78] == opp_colour)
-			opp_discs++;
-		if (board[77] == my_colour)
-			my_discs++;
-		else if (board[77] == opp_colour)
-			opp_discs++;
-		if (board[87] == my_colour)
-			my_discs++;
-		else if (board[87] == opp_colour)
-			opp_discs++;
-	}
-	stabilityCorners = -12.5 * (my_discs - opp_discs);
+	cornersScore = 25 * (features.corner_discs[me] - features.corner_discs[them]);
+
+	// Corner closeness: the three squares next to each empty corner
+	uint64_t close = 0;
+	if (empty & SQ_BIT(0))
+		close |= SQ_BIT(1) | SQ_BIT(8) | SQ_BIT(9);
+	if (empty & SQ_BIT(7))
+		close |= SQ_BIT(6) | SQ_BIT(14) | SQ_BIT(15);
+	if (empty & SQ_BIT(56))
+		close |= SQ_BIT(57) | SQ_BIT(48) | SQ_BIT(49);
+	if (empty & SQ_BIT(63))
+		close |= SQ_BIT(62) | SQ_BIT(54) | SQ_BIT(55);
+	stabilityCorners = -12.5 * (bb_count(own & close) - bb_count(opp & close));
 
 	// Mobility
-
-	int *playerMoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-	int *opponentMoves = (int *)malloc(LEGALMOVSBUFSIZE * sizeof(int));
-
-	legal_moves(my_colour, playerMoves, NULL);
-	legal_moves(opp_colour, opponentMoves, NULL);
-
-	my_discs = playerMoves[0];
-	opp_discs = opponentMoves[0];
+	my_discs = bb_count(bb_moves(own, opp));
+	opp_discs = bb_count(bb_moves(opp, own));
 	if (my_discs > opp_discs)
 		mobilityScore = (100.0 * my_discs) / (my_discs + opp_discs);
 	else if (my_discs < opp_discs)
@@ -1216,46 +3016,9 @@ int all_in_one(int my_colour, int d, int c, int s, int m, int e, int w)
  */
 int evaluateCorner(int my_colour, FILE *fp)
 {
-	int score = 0;
-	int x;
-	int y;
-	int val;
-	for (int i = 11; i <= 88; i++)
-	{
-		if (board[i] != EMPTY)
-		{
-			x = i / 10;
-			y = i % 10;
-			val = stabilityWeights2[x - 1][y - 1];
-			if (board[i] == my_colour)
-				score += val;
-			else
-				score -= val;
-
-			switch (i)
-			{
-			case 11:
-				if (board[i] != my_colour)
-					score -= 10;
-				break;
-			case 18:
-				if (board[i] != my_colour)
-					score -= 10;
-				break;
-			case 81:
-				if (board[i] != my_colour)
-					score -= 10;
-				break;
-			case 88:
-				if (board[i] != my_colour)
-					score -= 10;
-				break;
-
-			default:
-				break;
-			}
-		}
-	}
+	int opp_colour = opponent(my_colour, fp);
+	int score = features.stability[my_colour - 1] - features.stability[opp_colour - 1];
+	score -= 10 * features.corner_discs[opp_colour - 1];
 	return 100 * score;
 }
 /**
@@ -1267,18 +3030,8 @@ int evaluateCorner(int my_colour, FILE *fp)
  */
 int evaluateDiscDifference(int my_colour, FILE *fp)
 {
-	int playerScore = 0, opponentScore = 0;
-	for (int i = 11; i <= 88; i++)
-	{
-		if (board[i] == my_colour)
-		{
-			playerScore++;
-		}
-		if (board[i] == opponent(my_colour, fp))
-		{
-			opponentScore++;
-		}
-	}
+	int playerScore = features.discs[my_colour - 1];
+	int opponentScore = features.discs[opponent(my_colour, fp) - 1];
 
 	return 100 * (playerScore - opponentScore) / (playerScore + opponentScore);
 }
@@ -1291,19 +3044,7 @@ int evaluateDiscDifference(int my_colour, FILE *fp)
  */
 int evaluateGameTime(int my_colour, FILE *fp)
 {
-	int playerScore = 0, opponentScore = 0;
-	for (int i = 11; i <= 88; i++)
-	{
-		if (board[i] == my_colour)
-		{
-			playerScore++;
-		}
-		if (board[i] == opponent(my_colour, fp))
-		{
-			opponentScore++;
-		}
-	}
-	int total_discs = ((playerScore + opponentScore) / 2) - 4;
+	int total_discs = ((features.discs[0] + features.discs[1]) / 2) - 4;
 	if (total_discs < 10)
 	{
 		return 0; //early stages
@@ -1318,86 +3059,227 @@ int evaluateGameTime(int my_colour, FILE *fp)
 	}
 }
 /**
- * @brief shares the alpha value between the different ranks, to increase pruning
+ * @brief creates the window holding the shared root bound. Scores are packed
+ * with the iteration serial in the high half so one MPI_MAX accumulate both
+ * publishes a score and makes anything left from an earlier iteration stale
+ */
+void bound_init()
+{
+	MPI_Win_allocate(rank == 0 ? 2 * sizeof(int64_t) : 0, sizeof(int64_t), MPI_INFO_NULL, MPI_COMM_WORLD, &bound_cell, &bound_win);
+	if (rank == 0)
+	{
+		bound_cell[0] = 0;
+		bound_cell[BOUND_STOP] = -1; //no search stopped, search_serial starts at 0
+	}
+	MPI_Win_lock_all(0, bound_win); //passive target, no rank has to join in
+}
+
+void bound_free()
+{
+	MPI_Win_unlock_all(bound_win);
+	MPI_Win_free(&bound_win);
+}
+
+/**
+ * @brief offers the exact score of a finished root move to every rank
  * 
- * @param alpha given current alpha value
- * @param my_rank current rank
- * @return int return the alpha vlaue or shared alpha depending if its larger
+ * @param score root move score
  */
-int alpha_sharing_top(int alpha, int my_rank)
+void publish_root_score(int score)
 {
-	MPI_Request request;
-	int alpha_recv = 0;
+	int64_t packed = ((int64_t)bound_serial << 32) | (uint32_t)(score - MIN);
+
+	root_bound = max(root_bound, score);
+	MPI_Accumulate(&packed, 1, MPI_INT64_T, 0, 0, 1, MPI_INT64_T, MPI_MAX, bound_win);
+	MPI_Win_flush(0, bound_win);
+}
+
+/**
+ * @brief reads the shared root bound, called every TIMECHECKNODES nodes
+ */
+void refresh_root_bound()
+{
+	int64_t packed;
 
-	if (my_rank != 0)
+	MPI_Fetch_and_op(NULL, &packed, MPI_INT64_T, 0, 0, MPI_NO_OP, bound_win);
+	MPI_Win_flush(0, bound_win);
+	if ((packed >> 32) == bound_serial)
+	{
+		root_bound = max(root_bound, (int)((int64_t)(uint32_t)packed + MIN));
+	}
+	if (rank != 0)
 	{
-		for (int p = 0; p <= size; p++)
+		MPI_Fetch_and_op(NULL, &packed, MPI_INT64_T, 0, BOUND_STOP, MPI_NO_OP, bound_win);
+		MPI_Win_flush(0, bound_win);
+		if (packed == search_serial)
 		{
-			if (p != my_rank)
-			{
-				MPI_Isend(&alpha, 1, MPI_INT, p, 5, MPI_COMM_WORLD, &request);
-				//fprintf(fp,"p is %d and rank is %d\n", p, rank); //send to all but itself
-			}
+			search_stopped = 1; //rank 0 is out of time or has the referee's next command
 		}
-		MPI_Iprobe(MPI_ANY_SOURCE, 5, MPI_COMM_WORLD, &alpha_recv, MPI_STATUS_IGNORE); //check if received alpha
+	}
+}
 
-		if (alpha_recv != 0)
-		{ //if alpha was sent
-			MPI_Recv(&alpha_sharing, 1, MPI_INT, MPI_ANY_SOURCE, 5, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-			alpha_recv = 0; //change alpha sharing variable for all ranks
-		}
-		alpha = max(alpha_sharing, alpha); //find max for pruning
+/**
+ * @brief rank 0 keeps the time for every rank: it stops the search once the
+ * deadline passes, or a ponder search once the referee has sent something, and
+ * tells the other ranks through the stop cell of bound_win
+ */
+void stop_check()
+{
+	int64_t serial = search_serial;
+
+	if (rank != 0 || search_stopped)
+		return;
+	if ((ponder.pondering && comms_cmd_ready()) || (!ponder.pondering && search_depth > 1 && MPI_Wtime() > search_deadline))
+	{
+		search_stopped = 1;
+		MPI_Accumulate(&serial, 1, MPI_INT64_T, 0, BOUND_STOP, 1, MPI_INT64_T, MPI_MAX, bound_win);
+		MPI_Win_flush(0, bound_win);
+	}
+}
+
+/**
+ * @brief rank 0 guesses the opponent's reply to the move just played from the
+ * transposition table and plays it on the board
+ * 
+ * @param my_colour players colour
+ * @param fp file
+ * @return int predicted reply, SQUARES if the opponent has to pass, -1 if there is nothing to ponder
+ */
+int ponder_predict(int my_colour, FILE *fp)
+{
+	int opp = opponent(my_colour, fp);
+	int moves[SQUARES + 1];
+	tt_entry_t entry;
+
+	legal_moves(opp, moves, fp);
+	if (moves[0] <= 0)
+	{
+		// the opponent passes and the position is ours already
+		return (bb_moves(DISCS(my_colour), DISCS(opp)) != 0) ? SQUARES : -1;
+	}
+	if (!tt_probe(tt_hash(&board) ^ (opp == WHITE ? zobrist_white : 0), &entry) || entry.move < 0 ||
+		entry.move >= SQUARES || !legalp(entry.move, opp, fp))
+	{
+		return -1; //book move or no search, no idea what comes next
 	}
-	return alpha;
+	make_move(entry.move, opp, fp);
+	return entry.move;
+}
+
+/**
+ * @brief searches the predicted position on every rank until rank 0 sees the
+ * referee's next command. The iterations it completes are kept for
+ * minimax_strategy to resume from on a hit
+ * 
+ * @param my_colour players colour
+ * @param fp file
+ */
+void ponder_strategy(int my_colour, FILE *fp)
+{
+	ponder.board = board;
+	ponder.depth = 0;
+	ponder.pondering = 1;
+	minimax_strategy(my_colour, fp);
+	ponder.pondering = 0;
+	if (rank == 0)
+		fprintf(fp, "Pondered to depth %d\n", ponder.depth);
 }
 
 /**
- * @brief board cpy
+ * @brief plays move for player on the global board
  * 
- * @param board original
- * @param cBoard copy
+ * @return uint64_t the discs that were flipped, needed by unmake_move
  */
-void duplicateBoard(int *board, int *cBoard)
+uint64_t make_move(int move, int player, FILE *fp)
+{
+	int side = player - 1;
+	uint64_t flips = bb_flips(move, DISCS(player), DISCS(opponent(player, fp)));
+	DISCS(player) |= SQ_BIT(move);
+	board_hash ^= zobrist[side][move];
+	features.discs[side]++;
+	features.stability[side] += stabilityWeights2[SQ_ROW(move)][SQ_COL(move)];
+	features.corners[side] += cornersWeights[SQ_ROW(move)][SQ_COL(move)];
+	features.corner_discs[side] += (CORNERS >> move) & 1;
+	pattern_update(&features.patterns, move, player); //the digit of a colour is its value
+	make_flips(flips, player, fp);
+	return flips;
+}
+
+void make_flips(uint64_t flips, int player, FILE *fp)
 {
-	for (int i = 0; i < BOARDSIZE; i++)
+	int side = player - 1, delta = (player == BLACK) ? -1 : 1, sq, n = 0;
+	DISCS(player) |= flips;
+	DISCS(opponent(player, fp)) &= ~flips;
+	board_hash ^= tt_flip_key(flips);
+	for (; flips; flips &= flips - 1, n++)
 	{
-		cBoard[i] = board[i];
+		sq = bb_first(flips);
+		features.stability[side] += stabilityWeights2[SQ_ROW(sq)][SQ_COL(sq)];
+		features.stability[!side] -= stabilityWeights2[SQ_ROW(sq)][SQ_COL(sq)];
+		features.corners[side] += cornersWeights[SQ_ROW(sq)][SQ_COL(sq)];
+		features.corners[!side] -= cornersWeights[SQ_ROW(sq)][SQ_COL(sq)];
+		pattern_update(&features.patterns, sq, delta);
 	}
+	features.discs[side] += n;
+	features.discs[!side] -= n;
 }
 
-void make_move(int move, int player, FILE *fp)
+/**
+ * @brief takes back a move made by make_move, restoring only the squares it changed
+ * 
+ * @param move square that was played
+ * @param flips discs flipped by the move, as returned by make_move
+ * @param player colour that made the move
+ */
+void unmake_move(int move, uint64_t flips, int player, FILE *fp)
 {
-	int i;
-	board[move] = player;
-	for (i = 0; i <= 7; i++)
-		make_flips(move, ALLDIRECTIONS[i], player, fp);
+	int side = player - 1;
+	make_flips(flips, opponent(player, fp), fp);
+	DISCS(player) &= ~SQ_BIT(move);
+	board_hash ^= zobrist[side][move];
+	features.discs[side]--;
+	features.stability[side] -= stabilityWeights2[SQ_ROW(move)][SQ_COL(move)];
+	features.corners[side] -= cornersWeights[SQ_ROW(move)][SQ_COL(move)];
+	features.corner_discs[side] -= (CORNERS >> move) & 1;
+	pattern_update(&features.patterns, move, -player);
 }
 
-void make_flips(int move, int dir, int player, FILE *fp)
+/**
+ * @brief recomputes the evaluation features from board, for when it was set
+ * wholesale rather than through make_move
+ */
+void features_init()
 {
-	int bracketer, c;
-	bracketer = would_flip(move, dir, player, fp);
-	if (bracketer)
+	int side;
+
+	for (side = 0; side < 2; side++)
 	{
-		c = move + dir;
-		do
-		{
-			board[c] = player;
-			c = c + dir;
-		} while (c != bracketer);
+		features.discs[side] = bb_count(board.disc[side]);
+		features.stability[side] = weightSum(board.disc[side], stabilityWeights2);
+		features.corners[side] = weightSum(board.disc[side], cornersWeights);
+		features.corner_discs[side] = bb_count(board.disc[side] & CORNERS);
 	}
+	pattern_index(&features.patterns, board.disc[0], board.disc[1]);
 }
 
 void print_board(FILE *fp)
 {
 	int row, col;
 	fprintf(fp, "   1 2 3 4 5 6 7 8 [%c=%d %c=%d]\n",
-			nameof(BLACK), count(BLACK, board), nameof(WHITE), count(WHITE, board));
-	for (row = 1; row <= 8; row++)
+			nameof(BLACK), count(BLACK, &board), nameof(WHITE), count(WHITE, &board));
+	for (row = 0; row < 8; row++)
 	{
-		fprintf(fp, "%d  ", row);
-		for (col = 1; col <= 8; col++)
-			fprintf(fp, "%c ", nameof(board[col + (10 * row)]));
+		fprintf(fp, "%d  ", row + 1);
+		for (col = 0; col < 8; col++)
+		{
+			int sq = row * 8 + col;
+			if (DISCS(BLACK) & SQ_BIT(sq))
+				fprintf(fp, "%c ", nameof(BLACK));
+			else if (DISCS(WHITE) & SQ_BIT(sq))
+				fprintf(fp, "%c ", nameof(WHITE));
+			else
+				fprintf(fp, "%c ", nameof(EMPTY));
+		}
 		fprintf(fp, "\n");
 	}
 	fflush(fp);
@@ -1409,12 +3291,7 @@ char nameof(int piece)
 	return (piecenames[piece]);
 }
 
-int count(int player, int *board)
+int count(int player, bitboard_t *b)
 {
-	int i, cnt;
-	cnt = 0;
-	for (i = 1; i <= 88; i++)
-		if (board[i] == player)
-			cnt++;
-	return cnt;
+	return bb_count(b->disc[player - 1]);
 }
@@ -0,0 +1,99 @@
+#include "bitboard.h"
+
+/* Masks that stop horizontal and diagonal shifts wrapping onto the next row */
+#define NOT_A_FILE 0xfefefefefefefefeULL
+#define NOT_H_FILE 0x7f7f7f7f7f7f7f7fULL
+
+/**
+ * Shifts every disc one square in direction dir (0..7), dropping discs that
+ * would leave the board.
+ */
+static inline uint64_t shift(uint64_t b, int dir)
+{
+	switch (dir)
+	{
+	case 0: /* north west */
+		return (b >> 9) & NOT_H_FILE;
+	case 1: /* north */
+		return b >> 8;
+	case 2: /* north east */
+		return (b >> 7) & NOT_A_FILE;
+	case 3: /* west */
+		return (b >> 1) & NOT_H_FILE;
+	case 4: /* east */
+		return (b << 1) & NOT_A_FILE;
+	case 5: /* south west */
+		return (b << 7) & NOT_H_FILE;
+	case 6: /* south */
+		return b << 8;
+	default: /* south east */
+		return (b << 9) & NOT_A_FILE;
+	}
+}
+
+/**
+ * Sets up the four centre discs of the standard starting position.
+ */
+void bb_init(bitboard_t *b)
+{
+	b->disc[0] = SQ_BIT(28) | SQ_BIT(35); /* black on "34" and "43" */
+	b->disc[1] = SQ_BIT(27) | SQ_BIT(36); /* white on "33" and "44" */
+}
+
+/**
+ * @brief all squares where own can play, found by flooding each direction
+ * through runs of opponent discs
+ *
+ * @param own discs of the player to move
+ * @param opp discs of the opponent
+ * @return uint64_t mask of legal moves
+ */
+uint64_t bb_moves(uint64_t own, uint64_t opp)
+{
+	uint64_t empty = ~(own | opp);
+	uint64_t moves = 0;
+	uint64_t run;
+	int dir;
+
+	for (dir = 0; dir < 8; dir++)
+	{
+		/* a run of opponent discs is at most 6 long */
+		run = shift(own, dir) & opp;
+		run |= shift(run, dir) & opp;
+		run |= shift(run, dir) & opp;
+		run |= shift(run, dir) & opp;
+		run |= shift(run, dir) & opp;
+		run |= shift(run, dir) & opp;
+		moves |= shift(run, dir) & empty;
+	}
+	return moves;
+}
+
+/**
+ * @brief discs that flip when own plays on sq
+ *
+ * @param sq square being played, assumed empty
+ * @param own discs of the player to move
+ * @param opp discs of the opponent
+ * @return uint64_t mask of opponent discs that change colour, 0 if sq is not legal
+ */
+uint64_t bb_flips(int sq, uint64_t own, uint64_t opp)
+{
+	uint64_t flips = 0;
+	uint64_t run, x;
+	int dir;
+
+	for (dir = 0; dir < 8; dir++)
+	{
+		run = 0;
+		x = shift(SQ_BIT(sq), dir);
+		while (x & opp)
+		{
+			run |= x;
+			x = shift(x, dir);
+		}
+		if (x & own)
+			flips |= run;
+	}
+	return flips;
+}
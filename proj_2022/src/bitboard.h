@@ -0,0 +1,39 @@
+#ifndef _BITBOARD_H
+#define _BITBOARD_H
+
+#include <stdint.h>
+
+/*
+ * Squares are numbered 0..63 row by row from the top left corner, so square
+ * (row, col) is bit row * 8 + col and maps directly onto the "rc" move string
+ * the referee uses.
+ */
+#define SQUARES 64
+#define SQ_BIT(sq) (1ULL << (sq))
+#define SQ_ROW(sq) ((sq) >> 3)
+#define SQ_COL(sq) ((sq) & 7)
+
+/**
+ * Position as two occupancy masks, indexed by colour - 1 (black, white).
+ */
+typedef struct
+{
+	uint64_t disc[2];
+} bitboard_t;
+
+void bb_init(bitboard_t *b);
+uint64_t bb_moves(uint64_t own, uint64_t opp);
+uint64_t bb_flips(int sq, uint64_t own, uint64_t opp);
+
+static inline int bb_count(uint64_t x)
+{
+	return __builtin_popcountll(x);
+}
+
+/* Index of the lowest set bit; x must be non-zero */
+static inline int bb_first(uint64_t x)
+{
+	return __builtin_ctzll(x);
+}
+
+#endif
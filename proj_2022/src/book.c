@@ -0,0 +1,220 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "book.h"
+
+static const book_entry_t *entries = NULL;
+static size_t entry_count;
+static void *mapping = NULL;
+static size_t mapping_size;
+
+/* Rows reversed */
+static inline uint64_t flip_vertical(uint64_t b)
+{
+	return __builtin_bswap64(b);
+}
+
+/* Columns reversed */
+static inline uint64_t mirror_horizontal(uint64_t b)
+{
+	b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+	b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+	return ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+}
+
+/* Rows become columns, square (r, c) moves to (c, r) */
+static inline uint64_t transpose(uint64_t b)
+{
+	uint64_t t;
+
+	t = 0x0f0f0f0f00000000ULL & (b ^ (b << 28));
+	b ^= t ^ (t >> 28);
+	t = 0x3333000033330000ULL & (b ^ (b << 14));
+	b ^= t ^ (t >> 14);
+	t = 0x5500550055005500ULL & (b ^ (b << 7));
+	b ^= t ^ (t >> 7);
+	return b;
+}
+
+/*
+ * The 8 symmetries of the board. Bit 2 of sym transposes, bit 1 flips the
+ * rows and bit 0 mirrors the columns, applied in that order. Each step undoes
+ * itself, so the inverse applies them in reverse.
+ */
+static uint64_t apply(uint64_t b, int sym)
+{
+	if (sym & 4)
+		b = transpose(b);
+	if (sym & 2)
+		b = flip_vertical(b);
+	if (sym & 1)
+		b = mirror_horizontal(b);
+	return b;
+}
+
+static uint64_t undo(uint64_t b, int sym)
+{
+	if (sym & 1)
+		b = mirror_horizontal(b);
+	if (sym & 2)
+		b = flip_vertical(b);
+	if (sym & 4)
+		b = transpose(b);
+	return b;
+}
+
+/* splitmix64 finaliser */
+static inline uint64_t mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * @brief key of a position that is the same for all 8 symmetric images of it
+ *
+ * @param b position
+ * @param side index into b->disc of the player to move
+ * @param sym set to the symmetry that maps b onto the canonical orientation
+ * @return uint64_t smallest key over the symmetries
+ */
+uint64_t book_key(const bitboard_t *b, int side, int *sym)
+{
+	uint64_t key, best = UINT64_MAX;
+	int s;
+
+	for (s = 0; s < 8; s++)
+	{
+		key = mix(apply(b->disc[side], s) ^ mix(apply(b->disc[!side], s) + 0x9e3779b97f4a7c15ULL));
+		if (key < best)
+		{
+			best = key;
+			*sym = s;
+		}
+	}
+	return best;
+}
+
+/* Square sq of the real board in the canonical orientation */
+int book_square(int sq, int sym)
+{
+	return bb_first(apply(SQ_BIT(sq), sym));
+}
+
+/* Square sq of the canonical orientation on the real board */
+int book_unsquare(int sq, int sym)
+{
+	return bb_first(undo(SQ_BIT(sq), sym));
+}
+
+/**
+ * @brief maps the book file into memory. Pages are only read in when a probe
+ * touches them, so opening costs nothing at start up
+ *
+ * @param path book file
+ * @return size_t number of positions, 0 if there is no usable book
+ */
+size_t book_open(const char *path)
+{
+	struct stat st;
+	uint64_t count;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return 0;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < 16)
+	{
+		close(fd);
+		return 0;
+	}
+	mapping_size = st.st_size;
+	mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		mapping = NULL;
+		return 0;
+	}
+	memcpy(&count, (char *)mapping + 8, sizeof(count));
+	if (memcmp(mapping, BOOK_MAGIC, 8) != 0 || mapping_size != 16 + count * sizeof(book_entry_t))
+	{
+		book_close();
+		return 0;
+	}
+	entries = (const book_entry_t *)((char *)mapping + 16);
+	entry_count = count;
+	return entry_count;
+}
+
+void book_close()
+{
+	if (mapping != NULL)
+		munmap(mapping, mapping_size);
+	mapping = NULL;
+	entries = NULL;
+	entry_count = 0;
+}
+
+/**
+ * @brief binary search for the position in the book
+ *
+ * @param b position
+ * @param side index into b->disc of the player to move
+ * @return int book move on the real board, -1 if the position is not in the book
+ */
+int book_probe(const bitboard_t *b, int side)
+{
+	size_t lo = 0, hi = entry_count, mid;
+	uint64_t key;
+	int sym;
+
+	if (entries == NULL)
+		return -1;
+	key = book_key(b, side, &sym);
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (entries[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == entry_count || entries[lo].key != key)
+		return -1;
+	return book_unsquare(entries[lo].move, sym);
+}
+
+static int by_key(const void *a, const void *b)
+{
+	uint64_t x = ((const book_entry_t *)a)->key, y = ((const book_entry_t *)b)->key;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief sorts the entries and writes them out as a book file
+ *
+ * @param path book file
+ * @param records positions, reordered by the sort
+ * @param n number of positions
+ * @return int 0 on success, -1 if the file could not be written
+ */
+int book_write(const char *path, book_entry_t *records, size_t n)
+{
+	uint64_t count = n;
+	FILE *out;
+	int ok;
+
+	qsort(records, n, sizeof(book_entry_t), by_key);
+	out = fopen(path, "wb");
+	if (out == NULL)
+		return -1;
+	ok = fwrite(BOOK_MAGIC, 1, 8, out) == 8 && fwrite(&count, sizeof(count), 1, out) == 1 &&
+		 fwrite(records, sizeof(book_entry_t), n, out) == n;
+	return (fclose(out) == 0 && ok) ? 0 : -1;
+}
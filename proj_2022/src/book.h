@@ -0,0 +1,32 @@
+#ifndef _BOOK_H
+#define _BOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+
+#define BOOK_DEFAULT_PATH "player/book.bin"
+#define BOOK_MAGIC "OTHBOOK1"
+
+/**
+ * One book position. The file is an 8 byte magic, a 64 bit record count and
+ * then these records sorted by key. Positions and moves are stored in the
+ * canonical orientation of book_key.
+ */
+typedef struct
+{
+	uint64_t key;
+	int8_t move;	  /* square in the canonical orientation */
+	uint8_t plies;	  /* moves played to reach the position */
+	uint8_t pad[6];
+} book_entry_t;
+
+size_t book_open(const char *path);
+void book_close();
+uint64_t book_key(const bitboard_t *b, int side, int *sym);
+int book_square(int sq, int sym);
+int book_unsquare(int sq, int sym);
+int book_probe(const bitboard_t *b, int side);
+int book_write(const char *path, book_entry_t *entries, size_t n);
+
+#endif
@@ -2,15 +2,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include "comms.h" 
 
-const int LENBUFSIZE=3;
-const int MSGBUFSIZE=100;
+/* Received bytes not yet handed out, a power of two. Frames are at most 2 + 99 bytes */
+#define RINGSIZE 256
 
 int comms_get_colour(int* my_colour);
+static int comms_wait(unsigned int n);
+static inline char ring_at(unsigned int i);
 
 static int socket_desc;
+static char ring[RINGSIZE];
+static unsigned int ring_head, ring_tail; //read and write counts, wrap with the ring
+static int closed;
 
 /**
  * Creates socket, connects to remote server, and calls comms_get_colour 
@@ -39,15 +47,23 @@ int comms_init_network(int* my_colour, unsigned long ip, int port) {
 		return FAILURE;
 	}
 
+	/* Non-blocking from here, everything is read through the ring */
+	fcntl(socket_desc, F_SETFL, fcntl(socket_desc, F_GETFL, 0) | O_NONBLOCK);
+	ring_head = ring_tail = 0;
+	closed = 0;
+
 	return comms_get_colour(my_colour);
 }
 
 /**
- * Creates socket, connects to remote server, and calls comms_get_colour 
+ * Receives the single digit colour the server opens with
  */
 int comms_get_colour(int* my_colour) {
 	char tempColour[2]; tempColour[1] = 0;
-	if(recv(socket_desc, tempColour , 1, 0) < 0){
+	if (comms_wait(1) == SUCCESS) {
+		tempColour[0] = ring_at(0);
+		ring_head++;
+	} else {
 		#ifdef DEBUG
 		printf("Comms error: Could not receive colour\n");
 		#endif
@@ -58,52 +74,103 @@ int comms_get_colour(int* my_colour) {
 }
 
 /**
- * Receives message from server, which includes a cmd 
- * and, if cmd == play_move, also the opponent's move 
+ * Moves whatever the socket holds into the ring without blocking. Returns
+ * FAILURE once the server has closed the connection or it failed
  */
-int comms_get_cmd(char cmd[], char move[]) {
-	int result = SUCCESS;
-	int msg_len;
-
-	char* tmp_cmd;
-	char* tmp_move;
-
-	char* len_buf = malloc(LENBUFSIZE*sizeof(char));
-	char* msg_buf = malloc(MSGBUFSIZE*sizeof(char)); 
-
-	memset(len_buf, 0, LENBUFSIZE);
-	memset(msg_buf, 0, MSGBUFSIZE);
-
-	if (recv(socket_desc, len_buf , 2, 0) < 0){
-		result = FAILURE;
-	} else {
+static int comms_fill() {
+	unsigned int space, n;
+	ssize_t got;
+
+	while (!closed && (space = RINGSIZE - (ring_tail - ring_head)) > 0) {
+		n = RINGSIZE - (ring_tail & (RINGSIZE - 1)); //contiguous room before the wrap
+		got = recv(socket_desc, &ring[ring_tail & (RINGSIZE - 1)], (n < space) ? n : space, 0);
+		if (got > 0) {
+			ring_tail += got;
+		} else if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+			closed = 1;
+		} else if (errno != EINTR) {
+			break;
+		}
+	}
+	return closed ? FAILURE : SUCCESS;
+}
 
-		msg_len = atoi(len_buf);
-	
-		if (recv(socket_desc, msg_buf, msg_len, 0) < 0){
-			result = FAILURE; 
-		} else {
+/**
+ * Blocks until at least n bytes are buffered, or the connection is gone
+ */
+static int comms_wait(unsigned int n) {
+	struct pollfd pfd;
+
+	pfd.fd = socket_desc;
+	pfd.events = POLLIN;
+	comms_fill();
+	while (ring_tail - ring_head < n && !closed) {
+		poll(&pfd, 1, -1);
+		comms_fill();
+	}
+	return (ring_tail - ring_head >= n) ? SUCCESS : FAILURE;
+}
 
-			msg_buf[msg_len] = '\0';
+static inline char ring_at(unsigned int i) {
+	return ring[(ring_head + i) & (RINGSIZE - 1)];
+}
 
-			//strok is a dangerous command: 
-			//- modifies argument
-			//- returns a ptr into argument 
-			//- maintains state, which is not thread-state  
-			tmp_cmd = strtok(msg_buf, " ");  //get ptr to cmd in msg_buf; 
-			tmp_move = strtok(NULL, " ");	//get ptr to move in msg_buf
+/**
+ * Length of the frame at the head of the ring, its two digit prefix
+ * included, 0 while it is not all here and -1 if the prefix is not a length
+ */
+static int comms_frame_length() {
+	char hi, lo;
+
+	if (ring_tail - ring_head < 2)
+		return 0;
+	hi = ring_at(0);
+	lo = ring_at(1);
+	if (hi < '0' || hi > '9' || lo < '0' || lo > '9')
+		return -1;
+	if (ring_tail - ring_head < (unsigned int)(2 + (hi - '0') * 10 + (lo - '0')))
+		return 0;
+	return 2 + (hi - '0') * 10 + (lo - '0');
+}
 
-			strncpy(cmd, tmp_cmd, CMDBUFSIZE); 
-			if (tmp_move != NULL) strncpy(move, tmp_move, MOVEBUFSIZE);
+/**
+ * Receives message from server, which includes a cmd 
+ * and, if cmd == play_move, also the opponent's move.
+ * Frames are reassembled in the ring however the bytes arrive,
+ * the words are copied straight out of it
+ */
+int comms_get_cmd(char cmd[], char move[]) {
+	int frame, i, n;
 
-			result = SUCCESS;
-		}
+	while ((frame = comms_frame_length()) == 0) {
+		if (comms_wait(ring_tail - ring_head + 1) == FAILURE)
+			return FAILURE;
+	}
+	if (frame < 0) {
+		#ifdef DEBUG
+		printf("Comms error: Bad message length\n");
+		#endif
+		return FAILURE;
 	}
 
-	free(len_buf);
-	free(msg_buf);
+	// first word is the command, the second (newline kept) the move
+	for (i = 2; i < frame && ring_at(i) == ' '; i++)
+		;
+	for (n = 0; i < frame && ring_at(i) != ' '; i++)
+		if (n < CMDBUFSIZE - 1)
+			cmd[n++] = ring_at(i);
+	cmd[n] = '\0';
+	for (; i < frame && ring_at(i) == ' '; i++)
+		;
+	if (i < frame) {
+		for (n = 0; i < frame && ring_at(i) != ' '; i++)
+			if (n < MOVEBUFSIZE - 1)
+				move[n++] = ring_at(i);
+		move[n] = '\0';
+	}
+	ring_head += frame;
 
-	return result;
+	return SUCCESS;
 }
 
 /**
@@ -111,10 +178,32 @@ int comms_get_cmd(char cmd[], char move[]) {
  * and, if cmd == play_move, also the opponent's move 
  */
 int comms_send_move(char my_move[]) {
-
-	if (send(socket_desc, my_move, strlen(my_move) , 0) < 0) {
-		return FAILURE;
+	struct pollfd pfd;
+	size_t sent = 0, len = strlen(my_move);
+	ssize_t n;
+
+	pfd.fd = socket_desc;
+	pfd.events = POLLOUT;
+	while (sent < len) {
+		n = send(socket_desc, my_move + sent, len - sent, 0);
+		if (n > 0) {
+			sent += n;
+		} else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+			poll(&pfd, 1, -1); //socket buffer full, rare for a few bytes
+		} else {
+			return FAILURE;
+		}
 	}
 
 	return SUCCESS;
 }
+
+/**
+ * Checks, without blocking, whether a whole command has arrived (or the
+ * connection is gone, which comms_get_cmd then reports), so a search can be
+ * cut short when the next command arrives. Cheap enough to call while searching
+ */
+int comms_cmd_ready() {
+	comms_fill();
+	return closed || comms_frame_length() != 0;
+}
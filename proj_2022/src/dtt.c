@@ -0,0 +1,132 @@
+#include <mpi.h>
+#include <string.h>
+#include "dtt.h"
+
+int dtt_enabled;
+
+/*
+ * One slot per index, the key XORed with the data word like the local table,
+ * so a slot torn by two ranks storing at once matches no key. Slots are only
+ * touched through MPI atomics, the owner's included, so reads never race
+ * with remote stores.
+ */
+static MPI_Win win;
+static uint64_t *slots; /* check, data pairs of this rank's share */
+static uint64_t slot_mask;
+static int ranks;
+static dtt_stats_t stats;
+static uint64_t pending[DTT_BATCH][2]; /* stores not yet known to have left, MPI may still read them */
+static int pending_count;
+
+/* Rank holding a key, from bits the slot index does not use */
+static inline int owner_of(uint64_t key)
+{
+	return (int)((key >> 40) % (uint64_t)ranks);
+}
+
+/**
+ * @brief allocates this rank's share of the table, called by every rank. The
+ * ranks agree on the smallest share asked for, so a key maps to the same slot
+ * wherever it is looked up
+ *
+ * @param megabytes share of this rank, 0 disables the table
+ * @return size_t bytes of this rank's share, 0 if disabled or there is only one rank
+ */
+size_t dtt_init(size_t megabytes)
+{
+	long count = 1, agreed;
+
+	MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+	while ((size_t)count * 2 * 2 * sizeof(uint64_t) <= (megabytes << 20))
+		count *= 2;
+	if (megabytes == 0 || ranks < 2)
+		count = 0;
+	MPI_Allreduce(&count, &agreed, 1, MPI_LONG, MPI_MIN, MPI_COMM_WORLD);
+	dtt_enabled = (agreed > 0);
+	if (!dtt_enabled)
+		return 0;
+
+	MPI_Win_allocate(agreed * 2 * sizeof(uint64_t), sizeof(uint64_t), MPI_INFO_NULL, MPI_COMM_WORLD, &slots, &win);
+	memset(slots, 0, agreed * 2 * sizeof(uint64_t));
+	slot_mask = agreed - 1;
+	MPI_Barrier(MPI_COMM_WORLD); //every share is cleared before anyone probes
+	MPI_Win_lock_all(0, win);	 //passive target, owners take no part
+	return agreed * 2 * sizeof(uint64_t);
+}
+
+void dtt_free()
+{
+	if (!dtt_enabled)
+		return;
+	dtt_flush();
+	MPI_Win_unlock_all(win);
+	MPI_Win_free(&win);
+	dtt_enabled = 0;
+}
+
+/**
+ * @brief fetches a position's slot from the rank that owns it
+ *
+ * @param key position key including the side to move
+ * @param entry filled with the entry if it is there
+ * @return int 1 if the position was found
+ */
+int dtt_probe(uint64_t key, tt_entry_t *entry)
+{
+	uint64_t slot[2];
+	int owner = owner_of(key);
+
+	stats.probes++;
+	MPI_Get_accumulate(NULL, 0, MPI_UINT64_T, slot, 2, MPI_UINT64_T, owner, (MPI_Aint)(2 * (key & slot_mask)), 2,
+					   MPI_UINT64_T, MPI_NO_OP, win);
+	MPI_Win_flush(owner, win);
+	if ((slot[0] ^ slot[1]) != key)
+		return 0;
+	tt_unpack(key, slot[1], entry);
+	stats.hits++;
+	return 1;
+}
+
+/**
+ * @brief writes a search result to the owner's slot, replacing what was there.
+ * Stores are not waited for one by one, every DTT_BATCH of them the buffers
+ * are reclaimed at once
+ *
+ * @param key position key including the side to move
+ * @param depth remaining depth searched
+ * @param bound TT_EXACT, TT_LOWER or TT_UPPER
+ * @param score score from the engine's point of view
+ * @param move best move found or TT_NOMOVE
+ */
+void dtt_store(uint64_t key, int depth, int bound, int score, int move)
+{
+	uint64_t *slot = pending[pending_count];
+
+	slot[1] = tt_pack(score, depth, bound, move, 0);
+	slot[0] = key ^ slot[1];
+	MPI_Accumulate(slot, 2, MPI_UINT64_T, owner_of(key), (MPI_Aint)(2 * (key & slot_mask)), 2, MPI_UINT64_T, MPI_REPLACE,
+				   win);
+	if (++pending_count == DTT_BATCH)
+		dtt_flush();
+}
+
+/**
+ * @brief completes the stores still pending, at the latest when a search ends
+ */
+void dtt_flush()
+{
+	if (!dtt_enabled || pending_count == 0)
+		return;
+	MPI_Win_flush_local_all(win);
+	pending_count = 0;
+}
+
+void dtt_reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+dtt_stats_t dtt_stats()
+{
+	return stats;
+}
@@ -0,0 +1,35 @@
+#ifndef _DTT_H
+#define _DTT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tt.h"
+
+#define DTT_DEFAULT_MB 16 /* per rank */
+#define DTT_MINDEPTH 6	  /* least remaining depth worth a remote lookup */
+#define DTT_BATCH 32	  /* stores in flight before their buffers are reclaimed */
+
+typedef struct
+{
+	long probes; /* remote lookups */
+	long hits;	 /* of them, found their position */
+} dtt_stats_t;
+
+/*
+ * Transposition table shared by all ranks, partitioned by hash: each rank
+ * holds the slots of the keys it owns in an MPI window, the others reach them
+ * with one-sided operations. Only the main thread of a rank may use it, and
+ * only near the root where a subtree costs more than the round trip. The
+ * local table sits in front of it as a cache.
+ */
+extern int dtt_enabled;
+
+size_t dtt_init(size_t megabytes);
+void dtt_free();
+int dtt_probe(uint64_t key, tt_entry_t *entry);
+void dtt_store(uint64_t key, int depth, int bound, int score, int move);
+void dtt_flush();
+void dtt_reset_stats();
+dtt_stats_t dtt_stats();
+
+#endif
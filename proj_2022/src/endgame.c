@@ -0,0 +1,264 @@
+#include <stddef.h>
+#include "endgame.h"
+
+/* Below this many empties moves are ordered by parity only */
+#define FASTEST_FIRST_EMPTIES 7
+
+/* The four 4x4 quadrants, parity is tracked per quadrant */
+static const uint64_t quadrant[4] = {0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL,
+									 0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL};
+
+static int (*should_stop)();
+
+/**
+ * @brief sets the callback polled once per interior node, the solver unwinds
+ * with a meaningless score once it returns non-zero
+ *
+ * @param stop abort check, also expected to count nodes
+ */
+void eg_init(int (*stop)())
+{
+	should_stop = stop;
+}
+
+/* Final disc differential for own, empties left on the board count for nobody */
+static inline int final_score(uint64_t own, uint64_t opp)
+{
+	return bb_count(own) - bb_count(opp);
+}
+
+/* Quadrant of a square */
+static inline int quadrant_of(int sq)
+{
+	return (SQ_ROW(sq) >> 2) * 2 + (SQ_COL(sq) >> 2);
+}
+
+/* Bit q set if quadrant q holds an odd number of empties */
+static inline int parity(uint64_t empty)
+{
+	int q, odd = 0;
+
+	for (q = 0; q < 4; q++)
+		odd |= (bb_count(empty & quadrant[q]) & 1) << q;
+	return odd;
+}
+
+/**
+ * Last empty square: whoever can play there does, otherwise it stays empty.
+ */
+static int solve_1(uint64_t own, uint64_t opp, int sq)
+{
+	uint64_t flips;
+	int n;
+
+	flips = bb_flips(sq, own, opp);
+	if (flips)
+	{
+		n = bb_count(own) + bb_count(flips) + 1;
+		return n - (SQUARES - n);
+	}
+	flips = bb_flips(sq, opp, own);
+	if (flips)
+	{
+		n = bb_count(own) - bb_count(flips);
+		return n - (SQUARES - n);
+	}
+	return final_score(own, opp);
+}
+
+static int solve_2(uint64_t own, uint64_t opp, int alpha, int beta, int sq1, int sq2, int passed)
+{
+	uint64_t flips;
+	int score, best = -EG_EXACT;
+
+	if ((flips = bb_flips(sq1, own, opp)) != 0)
+	{
+		best = -solve_1(opp & ~flips, own | flips | SQ_BIT(sq1), sq2);
+		if (best >= beta)
+			return best;
+	}
+	if ((flips = bb_flips(sq2, own, opp)) != 0)
+	{
+		score = -solve_1(opp & ~flips, own | flips | SQ_BIT(sq2), sq1);
+		return (score > best) ? score : best;
+	}
+	if (best > -EG_EXACT)
+		return best;
+	if (passed)
+		return final_score(own, opp);
+	return -solve_2(opp, own, -beta, -alpha, sq1, sq2, 1);
+}
+
+static int solve_3(uint64_t own, uint64_t opp, int alpha, int beta, int sq1, int sq2, int sq3, int passed)
+{
+	uint64_t flips;
+	int score, best = -EG_EXACT;
+
+	if ((flips = bb_flips(sq1, own, opp)) != 0)
+	{
+		best = -solve_2(opp & ~flips, own | flips | SQ_BIT(sq1), -beta, -alpha, sq2, sq3, 0);
+		if (best >= beta)
+			return best;
+		alpha = (best > alpha) ? best : alpha;
+	}
+	if ((flips = bb_flips(sq2, own, opp)) != 0)
+	{
+		score = -solve_2(opp & ~flips, own | flips | SQ_BIT(sq2), -beta, -alpha, sq1, sq3, 0);
+		if (score >= beta)
+			return score;
+		best = (score > best) ? score : best;
+		alpha = (best > alpha) ? best : alpha;
+	}
+	if ((flips = bb_flips(sq3, own, opp)) != 0)
+	{
+		score = -solve_2(opp & ~flips, own | flips | SQ_BIT(sq3), -beta, -alpha, sq1, sq2, 0);
+		best = (score > best) ? score : best;
+	}
+	if (best > -EG_EXACT)
+		return best;
+	if (passed)
+		return final_score(own, opp);
+	return -solve_3(opp, own, -beta, -alpha, sq1, sq2, sq3, 1);
+}
+
+static int solve_4(uint64_t own, uint64_t opp, int alpha, int beta, int *sq, int passed)
+{
+	uint64_t flips;
+	int i, score, best = -EG_EXACT;
+	int rest[4][3] = {{sq[1], sq[2], sq[3]}, {sq[0], sq[2], sq[3]}, {sq[0], sq[1], sq[3]}, {sq[0], sq[1], sq[2]}};
+
+	for (i = 0; i < 4; i++)
+	{
+		if ((flips = bb_flips(sq[i], own, opp)) != 0)
+		{
+			score = -solve_3(opp & ~flips, own | flips | SQ_BIT(sq[i]), -beta, -alpha, rest[i][0], rest[i][1], rest[i][2], 0);
+			if (score >= beta)
+				return score;
+			best = (score > best) ? score : best;
+			alpha = (best > alpha) ? best : alpha;
+		}
+	}
+	if (best > -EG_EXACT)
+		return best;
+	if (passed)
+		return final_score(own, opp);
+	return -solve_4(opp, own, -beta, -alpha, sq, 1);
+}
+
+/**
+ * Four empties: squares alone in an odd quadrant are tried first, as in the
+ * 2-1-1 split where playing the singletons first usually wins the last move.
+ */
+static int solve_small(uint64_t own, uint64_t opp, int alpha, int beta)
+{
+	uint64_t empty = ~(own | opp);
+	int sq[4], n = 0, odd = parity(empty);
+	uint64_t e;
+
+	for (e = empty; e; e &= e - 1)
+	{
+		if (odd & (1 << quadrant_of(bb_first(e))))
+			sq[n++] = bb_first(e);
+	}
+	for (e = empty; e; e &= e - 1)
+	{
+		if (!(odd & (1 << quadrant_of(bb_first(e)))))
+			sq[n++] = bb_first(e);
+	}
+	switch (n)
+	{
+	case 0:
+		return final_score(own, opp);
+	case 1:
+		return solve_1(own, opp, sq[0]);
+	case 2:
+		return solve_2(own, opp, alpha, beta, sq[0], sq[1], 0);
+	case 3:
+		return solve_3(own, opp, alpha, beta, sq[0], sq[1], sq[2], 0);
+	default:
+		return solve_4(own, opp, alpha, beta, sq, 0);
+	}
+}
+
+/**
+ * Negamax over the remaining empties. Moves that leave the opponent the
+ * fewest replies go first, ties and the shallow part of the tree are broken
+ * by quadrant parity.
+ */
+static int solve(uint64_t own, uint64_t opp, int alpha, int beta, int empties, int passed)
+{
+	uint64_t moves, flips[SQUARES], move_bits;
+	int sq[SQUARES], key[SQUARES];
+	int n = 0, i, j, tmp_sq, tmp_key, odd, score, best = -EG_EXACT;
+	uint64_t tmp_flips;
+
+	if (empties <= 4)
+		return solve_small(own, opp, alpha, beta);
+	if (should_stop != NULL && should_stop())
+		return 0; /* result is discarded */
+
+	moves = bb_moves(own, opp);
+	if (moves == 0)
+	{
+		if (passed || bb_moves(opp, own) == 0)
+			return final_score(own, opp);
+		return -solve(opp, own, -beta, -alpha, empties, 1);
+	}
+
+	odd = parity(~(own | opp));
+	for (move_bits = moves; move_bits; move_bits &= move_bits - 1)
+	{
+		sq[n] = bb_first(move_bits);
+		flips[n] = bb_flips(sq[n], own, opp);
+		key[n] = (odd & (1 << quadrant_of(sq[n]))) ? 0 : 1;
+		if (empties > FASTEST_FIRST_EMPTIES)
+			key[n] += 2 * bb_count(bb_moves(opp & ~flips[n], own | flips[n] | SQ_BIT(sq[n])));
+		n++;
+	}
+	// insertion sort, lowest key first
+	for (i = 1; i < n; i++)
+	{
+		tmp_sq = sq[i];
+		tmp_key = key[i];
+		tmp_flips = flips[i];
+		for (j = i - 1; j >= 0 && key[j] > tmp_key; j--)
+		{
+			sq[j + 1] = sq[j];
+			key[j + 1] = key[j];
+			flips[j + 1] = flips[j];
+		}
+		sq[j + 1] = tmp_sq;
+		key[j + 1] = tmp_key;
+		flips[j + 1] = tmp_flips;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		score = -solve(opp & ~flips[i], own | flips[i] | SQ_BIT(sq[i]), -beta, -alpha, empties - 1, 0);
+		if (score > best)
+		{
+			best = score;
+			if (best > alpha)
+				alpha = best;
+			if (alpha >= beta)
+				break;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief final disc differential with perfect play, for the side to move.
+ * A window of (-EG_WLD, EG_WLD) only decides win, loss or draw, which is
+ * much cheaper
+ *
+ * @param own discs of the player to move
+ * @param opp discs of the opponent
+ * @param alpha lower bound of the window
+ * @param beta upper bound of the window
+ * @return int score, only a bound if it falls outside the window
+ */
+int eg_solve(uint64_t own, uint64_t opp, int alpha, int beta)
+{
+	return solve(own, opp, alpha, beta, SQUARES - bb_count(own | opp), 0);
+}
@@ -0,0 +1,14 @@
+#ifndef _ENDGAME_H
+#define _ENDGAME_H
+
+#include "bitboard.h"
+
+#define EG_DEFAULT_EMPTIES 14 /* solve exactly from this many empties down */
+#define EG_WLD_EXTRA 2		  /* win/loss/draw is cheap enough this many empties earlier */
+#define EG_EXACT 65			  /* solve window bounds, final disc differentials fit inside */
+#define EG_WLD 1
+
+void eg_init(int (*stop)());
+int eg_solve(uint64_t own, uint64_t opp, int alpha, int beta);
+
+#endif
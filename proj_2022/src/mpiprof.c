@@ -0,0 +1,291 @@
+#include <mpi.h>
+#include <stdlib.h>
+#include "mpiprof.h"
+
+#ifdef MPIPROF
+
+/*
+ * Every MPI call the engine makes goes through a wrapper here that times the
+ * PMPI call underneath, so the time of a blocking call includes waiting for
+ * the other ranks. MPI is only called from the main thread of a rank.
+ */
+enum
+{
+	PROF_BCAST,
+	PROF_GATHER,
+	PROF_GATHERV,
+	PROF_ALLREDUCE,
+	PROF_IALLREDUCE,
+	PROF_TEST,
+	PROF_SEND,
+	PROF_RECV,
+	PROF_PROBE,
+	PROF_IPROBE,
+	PROF_ACCUMULATE,
+	PROF_FETCH_AND_OP,
+	PROF_WIN_FLUSH,
+	PROF_GET_ACCUMULATE,
+	PROF_WIN_FLUSH_LOCAL_ALL,
+	PROF_CALLS
+};
+
+static const char *call_names[PROF_CALLS] = {"MPI_Bcast", "MPI_Gather", "MPI_Gatherv", "MPI_Allreduce",
+											 "MPI_Iallreduce", "MPI_Test", "MPI_Send", "MPI_Recv", "MPI_Probe",
+											 "MPI_Iprobe", "MPI_Accumulate", "MPI_Fetch_and_op", "MPI_Win_flush",
+											 "MPI_Get_accumulate", "MPI_Win_flush_local_all"};
+
+/* Totals of one call, all doubles so a rank's table goes as one array */
+typedef struct
+{
+	double count, bytes, seconds;
+	double move_seconds; /* of that, inside gen_move */
+} prof_call_t;
+
+#define PROF_DOUBLES (PROF_CALLS * (int)(sizeof(prof_call_t) / sizeof(double)))
+
+static prof_call_t calls[PROF_CALLS];
+static double move_comm[MPIPROF_MAXMOVES]; /* seconds in MPI calls during each move */
+static double move_wall[MPIPROF_MAXMOVES]; /* seconds of each move */
+static int moves;
+static int in_move;
+static double move_start;
+
+static void prof_add(int call, double bytes, double seconds)
+{
+	calls[call].count++;
+	calls[call].bytes += bytes;
+	calls[call].seconds += seconds;
+	if (in_move)
+	{
+		calls[call].move_seconds += seconds;
+		move_comm[moves] += seconds;
+	}
+}
+
+static double type_bytes(int count, MPI_Datatype type)
+{
+	int size;
+
+	PMPI_Type_size(type, &size);
+	return (double)count * size;
+}
+
+/**
+ * @brief starts a move, the calls until mpiprof_move_end are charged to it
+ */
+void mpiprof_move_begin()
+{
+	if (moves < MPIPROF_MAXMOVES)
+	{
+		in_move = 1;
+		move_start = PMPI_Wtime();
+	}
+}
+
+void mpiprof_move_end()
+{
+	if (in_move)
+	{
+		move_wall[moves++] = PMPI_Wtime() - move_start;
+		in_move = 0;
+	}
+}
+
+/**
+ * @brief gathers every rank's tables on rank 0, which writes one line per call
+ * and rank, then the share of each move spent in MPI calls on the slowest rank
+ *
+ * @param fp file, only used on rank 0
+ */
+void mpiprof_report(FILE *fp)
+{
+	int rank, size, r, c, m;
+	double *all_calls = NULL, *all_comm = NULL, comm, total;
+
+	PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	PMPI_Comm_size(MPI_COMM_WORLD, &size);
+	if (rank == 0)
+	{
+		all_calls = (double *)malloc(size * sizeof(calls));
+		all_comm = (double *)malloc(size * sizeof(move_comm));
+	}
+	PMPI_Gather(calls, PROF_DOUBLES, MPI_DOUBLE, all_calls, PROF_DOUBLES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	PMPI_Gather(move_comm, MPIPROF_MAXMOVES, MPI_DOUBLE, all_comm, MPIPROF_MAXMOVES, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	if (rank != 0 || fp == NULL)
+	{
+		free(all_calls);
+		free(all_comm);
+		return;
+	}
+	for (r = 0; r < size; r++)
+	{
+		prof_call_t *table = (prof_call_t *)all_calls + r * PROF_CALLS;
+		for (c = 0, total = 0; c < PROF_CALLS; c++)
+		{
+			if (table[c].count == 0)
+				continue;
+			fprintf(fp, "MPI rank=%d call=%s count=%.0f bytes=%.0f seconds=%.4f move_seconds=%.4f\n", r, call_names[c],
+					table[c].count, table[c].bytes, table[c].seconds, table[c].move_seconds);
+			total += table[c].move_seconds;
+		}
+		fprintf(fp, "MPI rank=%d move_seconds=%.4f\n", r, total);
+	}
+	for (m = 0; m < moves; m++)
+	{
+		for (r = 0, comm = 0; r < size; r++)
+			comm = (all_comm[r * MPIPROF_MAXMOVES + m] > comm) ? all_comm[r * MPIPROF_MAXMOVES + m] : comm;
+		fprintf(fp, "MPI move=%d seconds=%.4f comm=%.4f share=%.3f\n", m + 1, move_wall[m], comm,
+				(move_wall[m] > 0) ? comm / move_wall[m] : 0.0);
+	}
+	fflush(fp);
+	free(all_calls);
+	free(all_comm);
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Bcast(buffer, count, datatype, root, comm);
+	prof_add(PROF_BCAST, type_bytes(count, datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+			   MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+	prof_add(PROF_GATHER, type_bytes(sendcount, sendtype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+				const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+	prof_add(PROF_GATHERV, type_bytes(sendcount, sendtype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+	prof_add(PROF_ALLREDUCE, type_bytes(count, datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm,
+				   MPI_Request *request)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, comm, request);
+	prof_add(PROF_IALLREDUCE, type_bytes(count, datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Test(request, flag, status);
+	prof_add(PROF_TEST, 0, PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Send(buf, count, datatype, dest, tag, comm);
+	prof_add(PROF_SEND, type_bytes(count, datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+	MPI_Status local;
+	double start = PMPI_Wtime();
+	int received = 0;
+	int rc = PMPI_Recv(buf, count, datatype, source, tag, comm, (status == MPI_STATUS_IGNORE) ? &local : status);
+	PMPI_Get_count((status == MPI_STATUS_IGNORE) ? &local : status, MPI_BYTE, &received);
+	prof_add(PROF_RECV, received, PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Probe(source, tag, comm, status);
+	prof_add(PROF_PROBE, 0, PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Iprobe(source, tag, comm, flag, status);
+	prof_add(PROF_IPROBE, 0, PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Accumulate(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype, int target_rank,
+				   MPI_Aint target_disp, int target_count, MPI_Datatype target_datatype, MPI_Op op, MPI_Win win)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Accumulate(origin_addr, origin_count, origin_datatype, target_rank, target_disp, target_count,
+							 target_datatype, op, win);
+	prof_add(PROF_ACCUMULATE, type_bytes(origin_count, origin_datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Fetch_and_op(const void *origin_addr, void *result_addr, MPI_Datatype datatype, int target_rank,
+					 MPI_Aint target_disp, MPI_Op op, MPI_Win win)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Fetch_and_op(origin_addr, result_addr, datatype, target_rank, target_disp, op, win);
+	prof_add(PROF_FETCH_AND_OP, type_bytes(1, datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Win_flush(int rank, MPI_Win win)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Win_flush(rank, win);
+	prof_add(PROF_WIN_FLUSH, 0, PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Get_accumulate(const void *origin_addr, int origin_count, MPI_Datatype origin_datatype, void *result_addr,
+					   int result_count, MPI_Datatype result_datatype, int target_rank, MPI_Aint target_disp,
+					   int target_count, MPI_Datatype target_datatype, MPI_Op op, MPI_Win win)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Get_accumulate(origin_addr, origin_count, origin_datatype, result_addr, result_count, result_datatype,
+								 target_rank, target_disp, target_count, target_datatype, op, win);
+	prof_add(PROF_GET_ACCUMULATE, type_bytes(result_count, result_datatype), PMPI_Wtime() - start);
+	return rc;
+}
+
+int MPI_Win_flush_local_all(MPI_Win win)
+{
+	double start = PMPI_Wtime();
+	int rc = PMPI_Win_flush_local_all(win);
+	prof_add(PROF_WIN_FLUSH_LOCAL_ALL, 0, PMPI_Wtime() - start);
+	return rc;
+}
+
+#else
+
+void mpiprof_move_begin()
+{
+}
+
+void mpiprof_move_end()
+{
+}
+
+void mpiprof_report(FILE *fp)
+{
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _MPIPROF_H
+#define _MPIPROF_H
+
+#include <stdio.h>
+
+#define MPIPROF_MAXMOVES 64 /* moves of one player recorded, a game has at most 60 plies */
+
+/*
+ * Optional profiling of the engine's MPI calls through the PMPI interface,
+ * compiled in with -DMPIPROF (make MPIPROF=1). Without it these do nothing.
+ */
+void mpiprof_move_begin();
+void mpiprof_move_end();
+void mpiprof_report(FILE *fp);
+
+#endif
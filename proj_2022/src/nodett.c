@@ -0,0 +1,52 @@
+#include <mpi.h>
+#include <string.h>
+#include "tt.h"
+#include "nodett.h"
+
+static MPI_Comm node_comm = MPI_COMM_NULL;
+static MPI_Win win = MPI_WIN_NULL;
+
+/**
+ * @brief allocates the node's table and hands it to tt.c, called by every
+ * rank. The first rank of each node owns and clears the memory, the others
+ * map it. Replaces tt_init for the table, the Zobrist keys still come from it
+ *
+ * @param megabytes size of the node's table
+ * @param node_ranks set to the number of ranks sharing it
+ * @return size_t bytes of the table, 0 if disabled
+ */
+size_t nodett_init(size_t megabytes, int *node_ranks)
+{
+	size_t bytes = tt_table_bytes(megabytes);
+	MPI_Aint size;
+	void *base;
+	int node_rank, unit;
+
+	tt_init(0);
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+	MPI_Comm_rank(node_comm, &node_rank);
+	MPI_Comm_size(node_comm, node_ranks);
+	MPI_Bcast(&bytes, sizeof(bytes), MPI_BYTE, 0, node_comm); //sized by the node's first rank
+	if (bytes == 0)
+		return 0;
+
+	MPI_Win_allocate_shared(node_rank == 0 ? bytes : 0, 1, MPI_INFO_NULL, node_comm, &base, &win);
+	MPI_Win_shared_query(win, 0, &size, &unit, &base);
+	if (node_rank == 0)
+		memset(base, 0, bytes);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, win); //loads and stores only, the slots need no locks
+	MPI_Barrier(node_comm);					 //cleared before anyone searches
+	return tt_attach(base, (size_t)size);
+}
+
+void nodett_free()
+{
+	if (win != MPI_WIN_NULL)
+	{
+		tt_free();
+		MPI_Win_unlock_all(win);
+		MPI_Win_free(&win);
+	}
+	if (node_comm != MPI_COMM_NULL)
+		MPI_Comm_free(&node_comm);
+}
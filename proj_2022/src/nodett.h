@@ -0,0 +1,15 @@
+#ifndef _NODETT_H
+#define _NODETT_H
+
+#include <stddef.h>
+
+/*
+ * One transposition table per node instead of one per rank: the ranks of a
+ * node allocate it together as an MPI shared window and tt.c uses it through
+ * plain loads and stores, so results are shared without messages and the
+ * memory does not grow with the ranks on the node.
+ */
+size_t nodett_init(size_t megabytes, int *node_ranks);
+void nodett_free();
+
+#endif
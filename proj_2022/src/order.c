@@ -0,0 +1,115 @@
+#include <string.h>
+#include "order.h"
+
+/* History scores are halved once one passes this, so old cutoffs fade out */
+#define HISTORY_MAX (1 << 20)
+#define KILLER_KEY (1 << 28) /* above any history key, HISTORY_MAX * 16 */
+
+/*
+ * Static square weights break ties between moves the search has learned
+ * nothing about, which keeps the old stability ordering until history builds up.
+ */
+static int static_weight[SQUARES];
+
+/*
+ * Per thread, each search thread learns from its own cutoffs. Killers are
+ * stored as square + 1 so the zeroed table holds none.
+ */
+static _Thread_local int killers[ORDER_MAXPLY][ORDER_KILLERS];
+static _Thread_local int history[2][SQUARES];
+static _Thread_local order_stats_t stats;
+
+/**
+ * @brief sets the static weights ordering falls back on
+ *
+ * @param weights per square weights, higher is tried first
+ */
+void order_init(int weights[8][8])
+{
+	int sq;
+
+	for (sq = 0; sq < SQUARES; sq++)
+		static_weight[sq] = weights[SQ_ROW(sq)][SQ_COL(sq)];
+}
+
+/* Sort key of a move, higher goes first */
+static inline int move_key(int move, int ply, int colour, int hash_move)
+{
+	if (move == hash_move)
+		return KILLER_KEY * 2;
+	if (move + 1 == killers[ply][0])
+		return KILLER_KEY + 1;
+	if (move + 1 == killers[ply][1])
+		return KILLER_KEY;
+	// history dominates, the static weights (|w| < 8) only break ties
+	return history[colour - 1][move] * 16 + static_weight[move];
+}
+
+/**
+ * @brief orders moves in place: hash move, the killers of the ply, then by
+ * history. Insertion sort, the lists are short and nothing is allocated
+ *
+ * @param moves count in moves[0], moves in moves[1..]
+ * @param ply distance from the root
+ * @param colour player to move
+ * @param hash_move move stored in the transposition table, or -1
+ */
+void order_moves(int *moves, int ply, int colour, int hash_move)
+{
+	int keys[SQUARES + 1];
+	int i, j, move, key;
+
+	for (i = 1; i <= moves[0]; i++)
+	{
+		move = moves[i];
+		key = move_key(move, ply, colour, hash_move);
+		for (j = i - 1; j >= 1 && keys[j] < key; j--)
+		{
+			keys[j + 1] = keys[j];
+			moves[j + 1] = moves[j];
+		}
+		keys[j + 1] = key;
+		moves[j + 1] = move;
+	}
+}
+
+/**
+ * @brief learns from moves[i] failing high: it becomes a killer of the ply and
+ * its history grows with the depth of the subtree it cut off
+ *
+ * @param moves ordered moves of the node
+ * @param i index of the move that caused the cutoff
+ * @param ply distance from the root
+ * @param colour player to move
+ * @param depth remaining depth of the node
+ */
+void order_cutoff(int *moves, int i, int ply, int colour, int depth)
+{
+	int move = moves[i], sq, c;
+	int *h = &history[colour - 1][move];
+
+	stats.cutoffs++;
+	stats.first += (i == 1);
+	if (killers[ply][0] != move + 1)
+	{
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = move + 1;
+	}
+	*h += depth * depth;
+	if (*h > HISTORY_MAX)
+	{
+		for (c = 0; c < 2; c++)
+			for (sq = 0; sq < SQUARES; sq++)
+				history[c][sq] /= 2;
+	}
+}
+
+void order_reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+order_stats_t order_stats()
+{
+	return stats;
+}
@@ -0,0 +1,25 @@
+#ifndef _ORDER_H
+#define _ORDER_H
+
+#include "bitboard.h"
+
+#define ORDER_MAXPLY (SQUARES + 1) /* the search never goes deeper than the empty squares */
+#define ORDER_KILLERS 2
+
+/**
+ * Cutoff counts of the calling thread since the last order_reset_stats. The
+ * share of cutoffs found by the first move measures how good the ordering is.
+ */
+typedef struct
+{
+	long cutoffs;
+	long first; /* cutoffs by the first move searched */
+} order_stats_t;
+
+void order_init(int weights[8][8]);
+void order_moves(int *moves, int ply, int colour, int hash_move);
+void order_cutoff(int *moves, int i, int ply, int colour, int depth);
+void order_reset_stats();
+order_stats_t order_stats();
+
+#endif
@@ -0,0 +1,253 @@
+#include "pattern.h"
+
+#define EDGE 0
+#define CORNER 1
+#define REGION 2 /* 2x5 next to a corner */
+#define DIAGONAL 3
+
+/**
+ * Weights of one game phase. Tables are built for each phase and the score
+ * is interpolated between the two phases either side of the disc count.
+ */
+typedef struct
+{
+	int discs;	   /* disc count the phase is tuned for */
+	int square;	   /* scale of the static square weights */
+	int corner;	   /* per corner disc */
+	int x_square;  /* per disc diagonally next to an empty corner */
+	int c_square;  /* per disc beside an empty corner on the edge */
+	int stable;	   /* per edge disc that can no longer be flipped */
+	int mobility;  /* per point of the 100 * (own - opp) / (own + opp) move ratio */
+	int disc;	   /* per point of the same ratio for discs */
+} phase_t;
+
+/*
+ * Seeded from the hand tuned evaluatePosition: the square weights and corner
+ * penalties of evaluateCorner early on, the all_in_one(10, 800, 400, 80, 80, 10)
+ * mix at the end.
+ */
+static const phase_t phases[PATTERN_PHASES] = {
+	{20, 100, 1000, -1000, -300, 100, 1, 0},
+	{40, 100, 1500, -1500, -600, 200, 1, 0},
+	{60, 10, 20000, -5000, -5000, 400, 80, 10},
+};
+
+/* Canonical squares of each type as row * 8 + col, placed in the top left */
+static const int shapes[PATTERN_TYPES][PATTERN_MAXSQUARES] = {
+	{0, 1, 2, 3, 4, 5, 6, 7},
+	{0, 1, 8, 9, 2, 16, 10, 17, 18},
+	{0, 1, 2, 3, 4, 8, 9, 10, 11, 12},
+	{0, 9, 18, 27, 36, 45, 54, 63},
+};
+static const int shape_size[PATTERN_TYPES] = {8, 9, 10, 8};
+
+/* Symmetries each type is placed with, as for the opening book */
+static const int placements[PATTERN_INSTANCES][2] = {
+	{EDGE, 0}, {EDGE, 2}, {EDGE, 4}, {EDGE, 5},
+	{CORNER, 0}, {CORNER, 1}, {CORNER, 2}, {CORNER, 3},
+	{REGION, 0}, {REGION, 1}, {REGION, 2}, {REGION, 3}, {REGION, 4}, {REGION, 5}, {REGION, 6}, {REGION, 7},
+	{DIAGONAL, 0}, {DIAGONAL, 1},
+};
+
+pattern_t patterns[PATTERN_INSTANCES];
+pattern_cover_t pattern_cover[SQUARES];
+static int *tables[PATTERN_PHASES][PATTERN_TYPES];
+static int table_store[PATTERN_PHASES][6561 + 19683 + 59049 + 6561];
+static const int powers[PATTERN_MAXSQUARES + 1] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561, 19683, 59049};
+
+/* Square (r, c) moved by a symmetry: bit 2 transposes, bit 1 flips rows, bit 0 mirrors columns */
+static int transform(int sq, int sym)
+{
+	int r = SQ_ROW(sq), c = SQ_COL(sq), t;
+
+	if (sym & 4)
+	{
+		t = r;
+		r = c;
+		c = t;
+	}
+	if (sym & 2)
+		r = 7 - r;
+	if (sym & 1)
+		c = 7 - c;
+	return r * 8 + c;
+}
+
+/* +1 for an own disc, -1 for an opponent disc, 0 if empty */
+static inline int sign(int digit)
+{
+	return (digit == 1) ? 1 : (digit == 2) ? -1 : 0;
+}
+
+/*
+ * Edge discs that cannot be flipped any more: runs of one colour starting in a
+ * corner, or every disc once the edge is full.
+ */
+static int edge_stability(const int *digit)
+{
+	int stable[8] = {0}, i, full = 1, total = 0;
+
+	for (i = 0; i < 8; i++)
+		full &= digit[i] != 0;
+	for (i = 0; i < 8 && digit[i] != 0 && digit[i] == digit[0]; i++)
+		stable[i] = 1;
+	for (i = 7; i >= 0 && digit[i] != 0 && digit[i] == digit[7]; i--)
+		stable[i] = 1;
+	for (i = 0; i < 8; i++)
+		total += (full || stable[i]) ? sign(digit[i]) : 0;
+	return total;
+}
+
+/**
+ * @brief value of one configuration of a pattern type in one phase
+ *
+ * @param type pattern type
+ * @param phase weights of the phase
+ * @param digit base 3 digits of the configuration
+ * @param share how many placements cover each canonical square
+ * @param weights static square weights
+ */
+static double configuration_value(int type, const phase_t *phase, const int *digit, const int *share, int weights[8][8])
+{
+	double value = 0;
+	int k, sq;
+
+	// static square weights, split between the placements covering a square
+	for (k = 0; k < shape_size[type]; k++)
+	{
+		sq = shapes[type][k];
+		value += (double)sign(digit[k]) * phase->square * weights[SQ_ROW(sq)][SQ_COL(sq)] / share[k];
+	}
+	if (type == CORNER)
+	{
+		// digits 0..3 are the corner, the C squares beside it and the X square
+		value += sign(digit[0]) * phase->corner;
+		if (digit[0] == 0)
+			value += (sign(digit[1]) + sign(digit[2])) * phase->c_square + sign(digit[3]) * phase->x_square;
+	}
+	else if (type == EDGE)
+	{
+		value += edge_stability(digit) * phase->stable;
+	}
+	return value;
+}
+
+/**
+ * @brief places the patterns on the board and fills the tables of every phase
+ *
+ * @param weights static square weights, symmetric under the board symmetries
+ */
+void pattern_init(int weights[8][8])
+{
+	int cover[SQUARES] = {0}, share[PATTERN_MAXSQUARES], digit[PATTERN_MAXSQUARES];
+	int i, k, p, sq, type, index, rest, offset;
+	double value;
+
+	for (i = 0; i < PATTERN_INSTANCES; i++)
+	{
+		patterns[i].type = placements[i][0];
+		patterns[i].size = shape_size[patterns[i].type];
+		for (k = 0; k < patterns[i].size; k++)
+		{
+			sq = transform(shapes[patterns[i].type][k], placements[i][1]);
+			patterns[i].squares[k] = sq;
+			pattern_cover[sq].instance[pattern_cover[sq].count] = i;
+			pattern_cover[sq].power[pattern_cover[sq].count] = powers[k];
+			pattern_cover[sq].count++;
+			cover[sq]++;
+		}
+	}
+	for (p = 0; p < PATTERN_PHASES; p++)
+	{
+		offset = 0;
+		for (type = 0; type < PATTERN_TYPES; type++)
+		{
+			tables[p][type] = &table_store[p][offset];
+			offset += powers[shape_size[type]];
+			for (k = 0; k < shape_size[type]; k++)
+				share[k] = cover[shapes[type][k]];
+			for (index = 0; index < powers[shape_size[type]]; index++)
+			{
+				for (k = 0, rest = index; k < shape_size[type]; k++, rest /= 3)
+					digit[k] = rest % 3;
+				value = configuration_value(type, &phases[p], digit, share, weights);
+				tables[p][type][index] = (int)(value + ((value < 0) ? -0.5 : 0.5));
+			}
+		}
+	}
+}
+
+/* 100 * (a - b) / (a + b), 0 when both are 0 */
+static inline int ratio(int a, int b)
+{
+	return (a + b == 0) ? 0 : 100 * (a - b) / (a + b);
+}
+
+/**
+ * @brief indices of every placement computed from scratch
+ *
+ * @param pi set to the indices
+ * @param first discs read as digit 1
+ * @param second discs read as digit 2
+ */
+void pattern_index(pattern_index_t *pi, uint64_t first, uint64_t second)
+{
+	int i, k, sq, index;
+
+	for (i = 0; i < PATTERN_INSTANCES; i++)
+	{
+		index = 0;
+		for (k = patterns[i].size - 1; k >= 0; k--)
+		{
+			sq = patterns[i].squares[k];
+			index = index * 3 + (int)((first >> sq) & 1) + 2 * (int)((second >> sq) & 1);
+		}
+		pi->index[i] = index;
+	}
+}
+
+/**
+ * @brief pattern evaluation, two table lookups per placement, blended
+ * between the phases either side of the disc count. Every term changes sign
+ * with the colours, so the score for second is exactly the negation
+ *
+ * @param pi indices of the placements for first and second
+ * @param first discs of the player the score is for
+ * @param second discs of the opponent
+ * @return int score for first
+ */
+int pattern_score(const pattern_index_t *pi, uint64_t first, uint64_t second)
+{
+	int discs = bb_count(first | second);
+	int lo = (discs < phases[1].discs) ? 0 : 1;
+	int i, score[2] = {0, 0}, span, mobility, disc_ratio;
+
+	for (i = 0; i < PATTERN_INSTANCES; i++)
+	{
+		score[0] += tables[lo][patterns[i].type][pi->index[i]];
+		score[1] += tables[lo + 1][patterns[i].type][pi->index[i]];
+	}
+	mobility = ratio(bb_count(bb_moves(first, second)), bb_count(bb_moves(second, first)));
+	disc_ratio = ratio(bb_count(first), bb_count(second));
+	score[0] += mobility * phases[lo].mobility + disc_ratio * phases[lo].disc;
+	score[1] += mobility * phases[lo + 1].mobility + disc_ratio * phases[lo + 1].disc;
+
+	span = phases[lo + 1].discs - phases[lo].discs;
+	discs = (discs < phases[0].discs) ? phases[0].discs : (discs > phases[PATTERN_PHASES - 1].discs) ? phases[PATTERN_PHASES - 1].discs : discs;
+	return (score[0] * (phases[lo + 1].discs - discs) + score[1] * (discs - phases[lo].discs)) / span;
+}
+
+/**
+ * @brief pattern evaluation of a position without maintained indices
+ *
+ * @param own discs of the player the score is for
+ * @param opp discs of the opponent
+ * @return int score for own
+ */
+int pattern_eval(uint64_t own, uint64_t opp)
+{
+	pattern_index_t pi;
+
+	pattern_index(&pi, own, opp);
+	return pattern_score(&pi, own, opp);
+}
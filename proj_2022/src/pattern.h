@@ -0,0 +1,69 @@
+#ifndef _PATTERN_H
+#define _PATTERN_H
+
+#include <stdint.h>
+#include "bitboard.h"
+
+#define PATTERN_TYPES 4		 /* edge, corner 3x3, corner 2x5, diagonal */
+#define PATTERN_INSTANCES 18 /* every placement of the types on the board */
+#define PATTERN_MAXSQUARES 10
+#define PATTERN_PHASES 3
+#define PATTERN_MAXCOVER 6	 /* most placements sharing one square, a corner */
+
+/**
+ * One placement of a pattern type. squares[k] holds the board square read as
+ * base 3 digit k of the index, digits are 0 empty, 1 own disc, 2 opponent disc.
+ */
+typedef struct
+{
+	int type;
+	int size;
+	int squares[PATTERN_MAXSQUARES];
+} pattern_t;
+
+/**
+ * Placements a square belongs to, with the power of 3 of its digit in each,
+ * so a disc placed or flipped moves every index it touches by a multiple.
+ */
+typedef struct
+{
+	int count;
+	int instance[PATTERN_MAXCOVER];
+	int power[PATTERN_MAXCOVER];
+} pattern_cover_t;
+
+/**
+ * Index of every placement for a fixed pair of colours, digit 1 for the
+ * discs of first and 2 for those of second.
+ */
+typedef struct
+{
+	int index[PATTERN_INSTANCES];
+} pattern_index_t;
+
+extern pattern_t patterns[PATTERN_INSTANCES];
+extern pattern_cover_t pattern_cover[SQUARES];
+
+void pattern_init(int weights[8][8]);
+void pattern_index(pattern_index_t *pi, uint64_t first, uint64_t second);
+int pattern_score(const pattern_index_t *pi, uint64_t first, uint64_t second);
+int pattern_eval(uint64_t own, uint64_t opp);
+
+/**
+ * @brief moves the indices for a square whose digit changed
+ *
+ * @param pi indices to update
+ * @param sq square that changed
+ * @param delta new digit minus old digit, e.g. 1 for a first disc placed, -1
+ * for a second disc flipped to first
+ */
+static inline void pattern_update(pattern_index_t *pi, int sq, int delta)
+{
+	const pattern_cover_t *cover = &pattern_cover[sq];
+	int c;
+
+	for (c = 0; c < cover->count; c++)
+		pi->index[cover->instance[c]] += delta * cover->power[c];
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "probcut.h"
+
+mpc_fit_t mpc_fits[MPC_PHASES][MPC_MAXDEPTH + 1][MPC_MAXDEPTH + 1];
+
+/* Bucket of a disc count, the start position has 4 */
+int mpc_phase(int discs)
+{
+	int phase = (discs - 4) / 10;
+	return (phase < MPC_PHASES) ? phase : MPC_PHASES - 1;
+}
+
+/**
+ * @brief shallow depths checked before a search of the given depth, cheapest
+ * first. They keep the parity of the deep search, since Othello scores swing
+ * between odd and even depths, and go no deeper than half of it
+ *
+ * @param deep remaining depth of the node
+ * @param shallow filled with the shallow depths
+ * @return int how many there are
+ */
+int mpc_shallow(int deep, int *shallow)
+{
+	int s, n = 0;
+
+	for (s = 2 - deep % 2; s <= deep / 2 && n < MPC_MAXSHALLOW; s += 2)
+		shallow[n++] = s;
+	return n;
+}
+
+/**
+ * @brief least squares fit of deep against shallow
+ *
+ * @param fit set to the line and residual deviation, sigma 0 if there are too few pairs
+ * @param shallow shallow scores
+ * @param deep deep scores of the same positions
+ * @param n number of pairs
+ */
+void mpc_fit(mpc_fit_t *fit, const double *shallow, const double *deep, int n)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0, ss = 0, r;
+	int i;
+
+	memset(fit, 0, sizeof(*fit));
+	if (n < MPC_MINSAMPLES)
+		return;
+	for (i = 0; i < n; i++)
+	{
+		sx += shallow[i];
+		sy += deep[i];
+		sxx += shallow[i] * shallow[i];
+		sxy += shallow[i] * deep[i];
+	}
+	if (n * sxx - sx * sx <= 0)
+		return; //every shallow score the same, nothing to predict from
+	fit->a = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	fit->b = (sy - fit->a * sx) / n;
+	for (i = 0; i < n; i++)
+	{
+		r = deep[i] - (fit->a * shallow[i] + fit->b);
+		ss += r * r;
+	}
+	fit->sigma = sqrt(ss / n);
+	if (fit->a <= 0 || fit->sigma <= 0)
+		memset(fit, 0, sizeof(*fit)); //no usable relation
+}
+
+/**
+ * @brief reads fits written by mpc_save. The file starts with the evaluation
+ * the scores came from, fits for another evaluation are not loaded
+ *
+ * @param path parameter file
+ * @param eval evaluation mode of the engine
+ * @return int number of fits loaded, 0 if the file is missing or for another evaluation
+ */
+int mpc_load(const char *path, int eval)
+{
+	FILE *in = fopen(path, "r");
+	int file_eval, phase, deep, s, count = 0;
+	mpc_fit_t fit;
+
+	memset(mpc_fits, 0, sizeof(mpc_fits));
+	if (in == NULL)
+		return 0;
+	if (fscanf(in, "probcut %d", &file_eval) != 1 || file_eval != eval)
+	{
+		fclose(in);
+		return 0;
+	}
+	while (fscanf(in, "%d %d %d %lf %lf %lf", &phase, &deep, &s, &fit.a, &fit.b, &fit.sigma) == 6)
+	{
+		if (phase < 0 || phase >= MPC_PHASES || deep < 1 || deep > MPC_MAXDEPTH || s < 1 || s >= deep)
+			continue;
+		mpc_fits[phase][deep][s] = fit;
+		count++;
+	}
+	fclose(in);
+	return count;
+}
+
+/**
+ * @brief writes the fitted entries of mpc_fits, one "phase deep shallow a b
+ * sigma" line each
+ *
+ * @param path parameter file
+ * @param eval evaluation mode the scores came from
+ * @return int 0 on success, -1 if the file could not be written
+ */
+int mpc_save(const char *path, int eval)
+{
+	FILE *out = fopen(path, "w");
+	int phase, deep, s;
+	const mpc_fit_t *fit;
+
+	if (out == NULL)
+		return -1;
+	fprintf(out, "probcut %d\n", eval);
+	for (phase = 0; phase < MPC_PHASES; phase++)
+		for (deep = 1; deep <= MPC_MAXDEPTH; deep++)
+			for (s = 1; s < deep; s++)
+			{
+				fit = &mpc_fits[phase][deep][s];
+				if (fit->sigma > 0)
+					fprintf(out, "%d %d %d %.6f %.3f %.3f\n", phase, deep, s, fit->a, fit->b, fit->sigma);
+			}
+	return (fclose(out) == 0) ? 0 : -1;
+}
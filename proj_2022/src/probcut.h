@@ -0,0 +1,30 @@
+#ifndef _PROBCUT_H
+#define _PROBCUT_H
+
+#define MPC_DEFAULT_PATH "player/probcut.txt"
+#define MPC_PHASES 6	  /* disc count buckets of 10 from the start position */
+#define MPC_MINDEPTH 3	  /* shallowest remaining depth a cut is tried at */
+#define MPC_MAXDEPTH 14	  /* deepest */
+#define MPC_MAXSHALLOW 3  /* shallow searches tried per depth */
+#define MPC_MINSAMPLES 20 /* pairs needed before a fit is trusted */
+#define MPC_DEFAULT_T 1.5 /* cut once the deep score is this many sigma outside the window */
+
+/**
+ * Linear model of the deep search score from a shallow search of the same
+ * position, deep = a * shallow + b, with the residual standard deviation
+ * sigma. Scores are for the player to move, sigma is 0 where nothing was fitted.
+ */
+typedef struct
+{
+	double a, b, sigma;
+} mpc_fit_t;
+
+extern mpc_fit_t mpc_fits[MPC_PHASES][MPC_MAXDEPTH + 1][MPC_MAXDEPTH + 1];
+
+int mpc_phase(int discs);
+int mpc_shallow(int deep, int *shallow);
+void mpc_fit(mpc_fit_t *fit, const double *shallow, const double *deep, int n);
+int mpc_load(const char *path, int eval);
+int mpc_save(const char *path, int eval);
+
+#endif
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+
+uint64_t zobrist[2][SQUARES];
+uint64_t zobrist_flip[SQUARES];
+uint64_t zobrist_white;
+
+/*
+ * Slots are read and written by several search threads without a lock, and
+ * by several ranks when the table lives in memory shared across a node. The
+ * key is stored XORed with the data word, so a slot torn by two writers at
+ * once no longer matches any key and is simply missed.
+ */
+typedef struct
+{
+	uint64_t check; /* key ^ data */
+	uint64_t data;	/* packed tt_entry_t fields, see tt_pack() */
+} tt_slot_t;
+
+static tt_slot_t *table = NULL;
+static int table_owned; /* allocated here rather than handed to tt_attach */
+static uint64_t bucket_mask;
+static uint8_t age;
+
+/**
+ * splitmix64, seeded the same on every rank so all ranks agree on the keys
+ */
+static uint64_t next_key(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * @brief fills the Zobrist keys and allocates the table, halving the size
+ * until the allocation succeeds
+ *
+ * @param megabytes requested table size, 0 disables the table
+ * @return size_t bytes actually allocated, 0 if not even one bucket fitted
+ */
+size_t tt_init(size_t megabytes)
+{
+	uint64_t state = 22548890;
+	size_t buckets;
+	int sq;
+
+	for (sq = 0; sq < SQUARES; sq++)
+	{
+		zobrist[0][sq] = next_key(&state);
+		zobrist[1][sq] = next_key(&state);
+		zobrist_flip[sq] = zobrist[0][sq] ^ zobrist[1][sq];
+	}
+	zobrist_white = next_key(&state);
+	if (megabytes == 0)
+		return 0; /* table disabled */
+
+	buckets = tt_table_bytes(megabytes) / (TT_BUCKETSIZE * sizeof(tt_slot_t));
+	while (buckets > 0)
+	{
+		table = malloc(buckets * TT_BUCKETSIZE * sizeof(tt_slot_t));
+		if (table != NULL)
+			break;
+		buckets /= 2;
+	}
+	if (table == NULL)
+		return 0;
+
+	table_owned = 1;
+	bucket_mask = buckets - 1;
+	tt_clear();
+	return buckets * TT_BUCKETSIZE * sizeof(tt_slot_t);
+}
+
+/**
+ * @brief size of the table tt_init makes for a request: the largest power of
+ * two number of buckets that fits
+ *
+ * @param megabytes requested table size
+ * @return size_t bytes, 0 if not even one bucket fits
+ */
+size_t tt_table_bytes(size_t megabytes)
+{
+	size_t buckets = 1;
+
+	if (megabytes == 0)
+		return 0;
+	while (buckets * 2 * TT_BUCKETSIZE * sizeof(tt_slot_t) <= (megabytes << 20))
+		buckets *= 2;
+	return buckets * TT_BUCKETSIZE * sizeof(tt_slot_t);
+}
+
+/**
+ * @brief uses memory from elsewhere as the table, e.g. shared with other
+ * processes, in place of allocating one. It is neither cleared nor freed
+ * here. Call tt_init(0) first for the Zobrist keys
+ *
+ * @param memory zeroed memory of tt_table_bytes() size
+ * @param bytes its size
+ * @return size_t bytes used
+ */
+size_t tt_attach(void *memory, size_t bytes)
+{
+	size_t buckets = bytes / (TT_BUCKETSIZE * sizeof(tt_slot_t));
+
+	tt_free();
+	if (memory == NULL || buckets == 0 || (buckets & (buckets - 1)) != 0)
+		return 0; /* the masking needs a power of two */
+	table = memory;
+	table_owned = 0;
+	bucket_mask = buckets - 1;
+	age = 0;
+	return bytes;
+}
+
+void tt_free()
+{
+	if (table_owned)
+		free(table);
+	table = NULL;
+	table_owned = 0;
+}
+
+void tt_clear()
+{
+	if (table != NULL)
+		memset(table, 0, (bucket_mask + 1) * TT_BUCKETSIZE * sizeof(tt_slot_t));
+	age = 0;
+}
+
+/**
+ * Marks entries from earlier moves as stale so they are replaced first.
+ */
+void tt_new_search()
+{
+	age++;
+}
+
+/**
+ * @brief hash of a position from scratch, used after a board arrives over MPI
+ *
+ * @param b position
+ * @return uint64_t Zobrist key without the side to move
+ */
+uint64_t tt_hash(const bitboard_t *b)
+{
+	uint64_t key = 0;
+	uint64_t discs;
+	int c;
+
+	for (c = 0; c < 2; c++)
+	{
+		discs = b->disc[c];
+		while (discs)
+		{
+			key ^= zobrist[c][bb_first(discs)];
+			discs &= discs - 1;
+		}
+	}
+	return key;
+}
+
+/**
+ * @brief looks a position up in its bucket
+ *
+ * @param key position key including the side to move
+ * @param entry filled with a copy of the matching entry
+ * @return int 1 if the position was found
+ */
+int tt_probe(uint64_t key, tt_entry_t *entry)
+{
+	tt_slot_t *bucket;
+	uint64_t check, data;
+	int i;
+
+	if (table == NULL)
+		return 0;
+	bucket = &table[(key & bucket_mask) * TT_BUCKETSIZE];
+	for (i = 0; i < TT_BUCKETSIZE; i++)
+	{
+		check = bucket[i].check;
+		data = bucket[i].data;
+		if ((check ^ data) == key)
+		{
+			tt_unpack(key, data, entry);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief stores a search result, replacing the same position, else an entry
+ * from an earlier move, else the shallowest entry in the bucket
+ *
+ * @param key position key including the side to move
+ * @param depth remaining depth searched
+ * @param bound TT_EXACT, TT_LOWER or TT_UPPER
+ * @param score score from the engine's point of view
+ * @param move best move found or TT_NOMOVE
+ */
+void tt_store(uint64_t key, int depth, int bound, int score, int move)
+{
+	tt_slot_t *bucket, *victim;
+	tt_entry_t old, worst;
+	uint64_t data;
+	int i, stale;
+
+	if (table == NULL)
+		return;
+	bucket = &table[(key & bucket_mask) * TT_BUCKETSIZE];
+	victim = &bucket[0];
+	tt_unpack(0, victim->data, &worst);
+	for (i = 0; i < TT_BUCKETSIZE; i++)
+	{
+		data = bucket[i].data;
+		tt_unpack(bucket[i].check ^ data, data, &old);
+		if (old.key == key)
+		{
+			victim = &bucket[i];
+			if (move == TT_NOMOVE)
+				move = old.move; /* keep the old hash move */
+			break;
+		}
+		stale = old.age != age;
+		if (stale > (worst.age != age) || (stale == (worst.age != age) && old.depth < worst.depth))
+		{
+			victim = &bucket[i];
+			worst = old;
+		}
+	}
+	data = tt_pack(score, depth, bound, move, age);
+	victim->check = key ^ data;
+	victim->data = data;
+}
@@ -0,0 +1,73 @@
+#ifndef _TT_H
+#define _TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard.h"
+
+#define TT_EXACT 0
+#define TT_LOWER 1 /* score is at least this (beta cutoff) */
+#define TT_UPPER 2 /* score is at most this (failed low) */
+
+#define TT_NOMOVE -1
+#define TT_BUCKETSIZE 4
+#define TT_DEFAULT_MB 64
+
+/**
+ * A transposition table entry as returned by tt_probe. The table keeps these
+ * packed into two 64 bit words, four of which fill a 64 byte bucket.
+ */
+typedef struct
+{
+	uint64_t key;
+	int32_t score;
+	int8_t depth; /* remaining depth the score was searched to */
+	uint8_t bound;
+	int8_t move;
+	uint8_t age;
+} tt_entry_t;
+
+extern uint64_t zobrist[2][SQUARES];
+extern uint64_t zobrist_flip[SQUARES];
+extern uint64_t zobrist_white;
+
+size_t tt_init(size_t megabytes);
+size_t tt_table_bytes(size_t megabytes);
+size_t tt_attach(void *memory, size_t bytes);
+void tt_free();
+void tt_clear();
+void tt_new_search();
+uint64_t tt_hash(const bitboard_t *b);
+int tt_probe(uint64_t key, tt_entry_t *entry);
+void tt_store(uint64_t key, int depth, int bound, int score, int move);
+
+/* The entry fields without the key, as one 64 bit word */
+static inline uint64_t tt_pack(int score, int depth, int bound, int move, int age)
+{
+	return (uint64_t)(uint32_t)score | (uint64_t)(uint8_t)depth << 32 | (uint64_t)(uint8_t)bound << 40 |
+		   (uint64_t)(uint8_t)move << 48 | (uint64_t)(uint8_t)age << 56;
+}
+
+static inline void tt_unpack(uint64_t key, uint64_t data, tt_entry_t *entry)
+{
+	entry->key = key;
+	entry->score = (int32_t)(uint32_t)data;
+	entry->depth = (int8_t)(data >> 32);
+	entry->bound = (uint8_t)(data >> 40);
+	entry->move = (int8_t)(data >> 48);
+	entry->age = (uint8_t)(data >> 56);
+}
+
+/* Hash change for a set of discs changing colour */
+static inline uint64_t tt_flip_key(uint64_t flips)
+{
+	uint64_t key = 0;
+	while (flips)
+	{
+		key ^= zobrist_flip[bb_first(flips)];
+		flips &= flips - 1;
+	}
+	return key;
+}
+
+#endif
@@ -0,0 +1,507 @@
+/*
+ * Local stand-in for the Java game server: plays games between two player
+ * executables over the same length-prefixed protocol comms.c speaks, and runs
+ * tournaments of them in parallel.
+ *
+ * player/referee [options] <player A> <player B>
+ *   -g games    opening pairs to play, each opening once with either colour (10)
+ *   -j jobs     games running at the same time (1)
+ *   -t seconds  time limit per move handed to the players (1)
+ *   -n ranks    MPI ranks per player (1)
+ *   -o plies    length of the random openings, 0 starts every game from the
+ *               start position (0). Needs players that understand force_move
+ *   -s seed     seed of the openings (1)
+ *   -m command  launcher the players are started with ("mpirun --oversubscribe")
+ *   -l dir      directory for the player logs (Logs)
+ *   -x          strict: a move taking longer than the time limit forfeits,
+ *               without the usual grace, and the referee exits with status 2
+ *               if any game ended in a forfeit or an error
+ *
+ * Each game is one "game" line of key=value pairs, followed by a "total" line
+ * with player A's win rate and both players' time per move.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../src/bitboard.h"
+#include "../src/book.h"
+
+#define MAXARGS 32
+#define MAXJOBS 64
+#define MAXOPENING 20		 /* longest opening in plies */
+#define CONNECT_SECONDS 30.0 /* for a player to start up and connect */
+#define TIME_GRACE 1.0		 /* past the time limit before a move is forfeited */
+
+typedef struct
+{
+	int games, jobs, np, plies, strict;
+	double time_limit;
+	unsigned long seed;
+	char *launcher;
+	const char *log_dir;
+	const char *player[2];
+} options_t;
+
+/* Moves played before the players take over, the same for both colour orders */
+typedef struct
+{
+	int count;
+	int move[MAXOPENING];
+} opening_t;
+
+/* Outcome of one game, written by the game process to the tournament */
+typedef struct
+{
+	int discs[2];	   /* indexed by player, A first */
+	int moves[2];	   /* moves each player was asked for */
+	double seconds[2]; /* total time taken over them */
+	double longest[2];
+	int forfeit;	   /* player that timed out, moved illegally or disconnected, -1 if none */
+} result_t;
+
+/* A player process and its connection */
+typedef struct
+{
+	pid_t pid;
+	int sock;
+	int colour; /* BLACK 1 or WHITE 2, as sent to the player */
+} seat_t;
+
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief starts a player through the launcher, listening on a free port it is
+ * told to connect to, and sends it its colour
+ *
+ * @param opts options
+ * @param player executable
+ * @param colour 1 for black, 2 for white
+ * @param log log file handed to the player
+ * @param seat filled with the process and its socket
+ * @return int 0 once connected, -1 on failure
+ */
+static int seat_player(const options_t *opts, const char *player, int colour, const char *log, seat_t *seat)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	struct pollfd pfd;
+	char launcher[256], port[16], limit[32], ranks[16], colour_char = '0' + colour;
+	char *argv[MAXARGS], *word;
+	int listener, argc = 0;
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0; /* any free port, so games can run side by side */
+	if (listener == -1 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+		getsockname(listener, (struct sockaddr *)&addr, &len) != 0)
+	{
+		perror("referee: listen");
+		return -1;
+	}
+
+	snprintf(launcher, sizeof(launcher), "%s", opts->launcher);
+	snprintf(port, sizeof(port), "%d", ntohs(addr.sin_port));
+	snprintf(limit, sizeof(limit), "%g", opts->time_limit);
+	snprintf(ranks, sizeof(ranks), "%d", opts->np);
+	for (word = strtok(launcher, " "); word != NULL && argc < MAXARGS - 8; word = strtok(NULL, " "))
+		argv[argc++] = word;
+	argv[argc++] = "-np";
+	argv[argc++] = ranks;
+	argv[argc++] = (char *)player;
+	argv[argc++] = "127.0.0.1";
+	argv[argc++] = port;
+	argv[argc++] = limit;
+	argv[argc++] = (char *)log;
+	argv[argc] = NULL;
+
+	seat->colour = colour;
+	seat->sock = -1;
+	seat->pid = fork();
+	if (seat->pid == 0)
+	{
+		close(listener);
+		execvp(argv[0], argv);
+		perror("referee: exec");
+		_exit(127);
+	}
+	pfd.fd = listener;
+	pfd.events = POLLIN;
+	if (seat->pid > 0 && poll(&pfd, 1, (int)(CONNECT_SECONDS * 1000)) == 1)
+		seat->sock = accept(listener, NULL, NULL);
+	close(listener);
+	if (seat->sock == -1 || send(seat->sock, &colour_char, 1, 0) != 1)
+	{
+		fprintf(stderr, "referee: %s did not connect\n", player);
+		return -1;
+	}
+	return 0;
+}
+
+/* Sends one message with its two digit length in front, as comms_get_cmd reads it */
+static int send_message(seat_t *seat, const char *msg)
+{
+	char frame[128];
+	int n = snprintf(frame, sizeof(frame), "%02d%s", (int)strlen(msg), msg);
+
+	return (send(seat->sock, frame, n, MSG_NOSIGNAL) == n) ? 0 : -1;
+}
+
+/**
+ * @brief reads a move reply, "rc\n" or "pass\n", within the time given
+ *
+ * @param seat player
+ * @param reply filled with the reply without the newline
+ * @param size size of reply
+ * @param seconds time allowed
+ * @return int 0 on a reply, -1 on a timeout or a closed connection
+ */
+static int read_reply(seat_t *seat, char *reply, int size, double seconds)
+{
+	double deadline = now() + seconds, left;
+	struct pollfd pfd;
+	int n = 0;
+	char c;
+
+	pfd.fd = seat->sock;
+	pfd.events = POLLIN;
+	while (n < size - 1)
+	{
+		left = deadline - now();
+		if (left <= 0 || poll(&pfd, 1, (int)(left * 1000) + 1) != 1 || recv(seat->sock, &c, 1, 0) != 1)
+			return -1;
+		if (c == '\n')
+			break;
+		reply[n++] = c;
+	}
+	reply[n] = '\0';
+	return 0;
+}
+
+/* Ends a player: game over if it is still listening, then the process */
+static void unseat_player(seat_t *seat)
+{
+	double deadline = now() + 10.0;
+	int status;
+
+	if (seat->sock != -1)
+	{
+		send_message(seat, "game_over");
+		close(seat->sock);
+	}
+	if (seat->pid <= 0)
+		return;
+	while (waitpid(seat->pid, &status, WNOHANG) == 0)
+	{
+		if (now() > deadline)
+		{
+			kill(seat->pid, SIGKILL); /* hung, e.g. a rank stuck in a collective */
+			waitpid(seat->pid, &status, 0);
+			break;
+		}
+		usleep(10000);
+	}
+}
+
+/**
+ * @brief plays one game from the opening, player A taking black unless swapped
+ *
+ * @param opts options
+ * @param opening moves played first
+ * @param swap player A plays white
+ * @param game game number, names the logs
+ * @param result filled with the outcome
+ */
+static void play_game(const options_t *opts, const opening_t *opening, int swap, int game, result_t *result)
+{
+	seat_t seats[2]; /* indexed by player */
+	bitboard_t board;
+	char log[256], msg[32], reply[16];
+	int p, side = 0, mover, loc, i, passes = 0;
+	uint64_t moves, flips;
+	double start, taken;
+
+	memset(result, 0, sizeof(*result));
+	memset(seats, 0, sizeof(seats));
+	seats[0].sock = seats[1].sock = -1;
+	result->forfeit = -1;
+	for (p = 0; p < 2 && result->forfeit == -1; p++)
+	{
+		snprintf(log, sizeof(log), "%s/game%d_%c.txt", opts->log_dir, game, 'A' + p);
+		if (seat_player(opts, opts->player[p], (p ^ swap) + 1, log, &seats[p]) != 0)
+			result->forfeit = p;
+	}
+
+	bb_init(&board);
+	for (i = 0; i < opening->count && result->forfeit == -1; i++, side = !side)
+	{
+		// the mover is told its own move, the other player hears it as usual
+		mover = side ^ swap;
+		snprintf(msg, sizeof(msg), "force_move %d%d", SQ_ROW(opening->move[i]), SQ_COL(opening->move[i]));
+		send_message(&seats[mover], msg);
+		snprintf(msg, sizeof(msg), "play_move %d%d", SQ_ROW(opening->move[i]), SQ_COL(opening->move[i]));
+		send_message(&seats[!mover], msg);
+		flips = bb_flips(opening->move[i], board.disc[side], board.disc[!side]);
+		board.disc[side] |= flips | SQ_BIT(opening->move[i]);
+		board.disc[!side] &= ~flips;
+	}
+
+	while (result->forfeit == -1 && passes < 2)
+	{
+		mover = side ^ swap;
+		moves = bb_moves(board.disc[side], board.disc[!side]);
+		if (moves == 0 && bb_moves(board.disc[!side], board.disc[side]) == 0)
+			break;
+		start = now();
+		if (send_message(&seats[mover], "gen_move") != 0 ||
+			read_reply(&seats[mover], reply, sizeof(reply), opts->time_limit + (opts->strict ? 0 : TIME_GRACE)) != 0)
+		{
+			result->forfeit = mover;
+			break;
+		}
+		taken = now() - start;
+		result->moves[mover]++;
+		result->seconds[mover] += taken;
+		result->longest[mover] = (taken > result->longest[mover]) ? taken : result->longest[mover];
+		if (strcmp(reply, "pass") == 0)
+		{
+			if (moves != 0)
+			{
+				result->forfeit = mover; //passed with a move available
+				break;
+			}
+			passes++;
+			send_message(&seats[!mover], "play_move pass\n");
+		}
+		else
+		{
+			loc = (reply[0] - '0') * 8 + (reply[1] - '0');
+			if (strlen(reply) != 2 || loc < 0 || loc >= SQUARES || !(moves & SQ_BIT(loc)))
+			{
+				result->forfeit = mover;
+				break;
+			}
+			passes = 0;
+			flips = bb_flips(loc, board.disc[side], board.disc[!side]);
+			board.disc[side] |= flips | SQ_BIT(loc);
+			board.disc[!side] &= ~flips;
+			snprintf(msg, sizeof(msg), "play_move %s", reply);
+			send_message(&seats[!mover], msg);
+		}
+		side = !side;
+	}
+	for (p = 0; p < 2; p++)
+	{
+		result->discs[p] = bb_count(board.disc[p ^ swap]);
+		unseat_player(&seats[p]);
+	}
+}
+
+/* splitmix64, for openings that repeat from the seed */
+static uint64_t next_random(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * @brief random openings of the given length, no two the same up to symmetry
+ *
+ * @param openings filled with count openings
+ * @param count openings wanted
+ * @param plies moves in each
+ * @param seed seed
+ */
+static void make_openings(opening_t *openings, int count, int plies, unsigned long seed)
+{
+	uint64_t state = seed, moves, flips, *keys = (uint64_t *)malloc(count * sizeof(uint64_t));
+	bitboard_t board;
+	int i = 0, j, k, side, loc, sym, tries = 0;
+
+	while (i < count)
+	{
+		bb_init(&board);
+		openings[i].count = 0;
+		for (k = 0, side = 0; k < plies; k++, side = !side)
+		{
+			moves = bb_moves(board.disc[side], board.disc[!side]);
+			if (moves == 0)
+				break; //no passes inside an opening
+			for (loc = (int)(next_random(&state) % bb_count(moves)); loc > 0; loc--)
+				moves &= moves - 1;
+			loc = bb_first(moves);
+			flips = bb_flips(loc, board.disc[side], board.disc[!side]);
+			board.disc[side] |= flips | SQ_BIT(loc);
+			board.disc[!side] &= ~flips;
+			openings[i].move[openings[i].count++] = loc;
+		}
+		keys[i] = book_key(&board, side, &sym);
+		for (j = 0; j < i && keys[j] != keys[i]; j++)
+			;
+		// short openings have few distinct positions, repeat them rather than loop forever
+		if (j == i || ++tries > 100 * count)
+			i++;
+	}
+	free(keys);
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: referee [-g games] [-j jobs] [-t seconds] [-n ranks] [-o plies] [-s seed] [-m launcher] "
+					"[-l logdir] [-x] <player A> <player B>\n");
+	exit(1);
+}
+
+/* A game process of the tournament */
+typedef struct
+{
+	pid_t pid; /* 0 if the slot is free */
+	int fd;	   /* read end of its result pipe */
+	int game;
+} job_t;
+
+int main(int argc, char *argv[])
+{
+	options_t opts = {10, 1, 1, 0, 0, 1.0, 1, "mpirun --oversubscribe", "Logs", {NULL, NULL}};
+	opening_t *openings;
+	result_t result, total;
+	job_t jobs[MAXJOBS];
+	int fds[2], games, next = 0, running = 0, done = 0, c, i, p, wins = 0, draws = 0, errors = 0, status;
+	pid_t pid;
+
+	while ((c = getopt(argc, argv, "g:j:t:n:o:s:m:l:x")) != -1)
+	{
+		switch (c)
+		{
+		case 'g':
+			opts.games = atoi(optarg);
+			break;
+		case 'j':
+			opts.jobs = atoi(optarg);
+			break;
+		case 't':
+			opts.time_limit = atof(optarg);
+			break;
+		case 'n':
+			opts.np = atoi(optarg);
+			break;
+		case 'o':
+			opts.plies = atoi(optarg);
+			break;
+		case 's':
+			opts.seed = strtoul(optarg, NULL, 10);
+			break;
+		case 'm':
+			opts.launcher = optarg;
+			break;
+		case 'l':
+			opts.log_dir = optarg;
+			break;
+		case 'x':
+			opts.strict = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc - optind != 2 || opts.games < 1)
+		usage();
+	opts.player[0] = argv[optind];
+	opts.player[1] = argv[optind + 1];
+	opts.jobs = (opts.jobs < 1) ? 1 : (opts.jobs > MAXJOBS) ? MAXJOBS : opts.jobs;
+	opts.plies = (opts.plies < 0) ? 0 : (opts.plies > MAXOPENING) ? MAXOPENING : opts.plies;
+	mkdir(opts.log_dir, 0755);
+
+	openings = (opening_t *)calloc(opts.games, sizeof(opening_t));
+	make_openings(openings, opts.games, opts.plies, opts.seed);
+	memset(&total, 0, sizeof(total));
+	memset(jobs, 0, sizeof(jobs));
+	games = 2 * opts.games;
+
+	// one process per game, its result comes back through a pipe
+	while (done < games)
+	{
+		while (running < opts.jobs && next < games)
+		{
+			for (i = 0; jobs[i].pid != 0; i++)
+				;
+			if (pipe(fds) != 0)
+			{
+				perror("referee: pipe");
+				return 1;
+			}
+			jobs[i].pid = fork();
+			if (jobs[i].pid == 0)
+			{
+				close(fds[0]);
+				play_game(&opts, &openings[next / 2], next % 2, next, &result);
+				_exit(write(fds[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+			}
+			close(fds[1]);
+			jobs[i].fd = fds[0];
+			jobs[i].game = next++;
+			running++;
+		}
+		pid = wait(&status);
+		for (i = 0; i < MAXJOBS && (jobs[i].pid != pid || pid <= 0); i++)
+			;
+		if (i == MAXJOBS)
+			continue;
+		if (read(jobs[i].fd, &result, sizeof(result)) != sizeof(result))
+		{
+			memset(&result, 0, sizeof(result));
+			result.forfeit = -2; //the game process died
+		}
+		close(jobs[i].fd);
+		jobs[i].pid = 0;
+		running--;
+		done++;
+
+		if (result.forfeit == -2)
+			errors++;
+		else if (result.forfeit == 1 || (result.forfeit == -1 && result.discs[0] > result.discs[1]))
+			wins++;
+		else if (result.forfeit == -1 && result.discs[0] == result.discs[1])
+			draws++;
+		for (p = 0; p < 2; p++)
+		{
+			total.moves[p] += result.moves[p];
+			total.seconds[p] += result.seconds[p];
+			total.longest[p] = (result.longest[p] > total.longest[p]) ? result.longest[p] : total.longest[p];
+		}
+		total.forfeit += (result.forfeit >= 0);
+		printf("game id=%d opening=%d a_colour=%s a_discs=%d b_discs=%d forfeit=%s a_move_seconds=%.3f "
+			   "b_move_seconds=%.3f\n",
+			   jobs[i].game, jobs[i].game / 2, (jobs[i].game % 2) ? "white" : "black", result.discs[0],
+			   result.discs[1], (result.forfeit == 0) ? "a" : (result.forfeit == 1) ? "b" : (result.forfeit == -1) ? "none" : "error",
+			   result.moves[0] ? result.seconds[0] / result.moves[0] : 0.0,
+			   result.moves[1] ? result.seconds[1] / result.moves[1] : 0.0);
+		fflush(stdout);
+	}
+	printf("total games=%d a_wins=%d draws=%d a_score=%.3f forfeits=%d errors=%d a_move_seconds=%.3f a_longest=%.3f "
+		   "b_move_seconds=%.3f b_longest=%.3f\n",
+		   games, wins, draws, (wins + 0.5 * draws) / games, total.forfeit, errors,
+		   total.moves[0] ? total.seconds[0] / total.moves[0] : 0.0, total.longest[0],
+		   total.moves[1] ? total.seconds[1] / total.moves[1] : 0.0, total.longest[1]);
+	free(openings);
+	return (opts.strict && (total.forfeit > 0 || errors > 0)) ? 2 : 0;
+}